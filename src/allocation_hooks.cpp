@@ -0,0 +1,28 @@
+// Replaces the global operator new and delete with the counting versions
+// behind AllocationScope. Linked into the executables only: a replacement in
+// the library would take over the allocator of every program that links it.
+
+#include <new>
+
+#include "memory_stats.h"
+
+void* operator new(std::size_t size) {
+    void* block = countedAllocate(size);
+    if (!block) throw std::bad_alloc();
+    return block;
+}
+
+void* operator new[](std::size_t size) {
+    void* block = countedAllocate(size);
+    if (!block) throw std::bad_alloc();
+    return block;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size); }
+void operator delete(void* block) noexcept { countedRelease(block); }
+void operator delete[](void* block) noexcept { countedRelease(block); }
+void operator delete(void* block, std::size_t) noexcept { countedRelease(block); }
+void operator delete[](void* block, std::size_t) noexcept { countedRelease(block); }
+void operator delete(void* block, const std::nothrow_t&) noexcept { countedRelease(block); }
+void operator delete[](void* block, const std::nothrow_t&) noexcept { countedRelease(block); }
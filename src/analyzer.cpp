@@ -0,0 +1,914 @@
+#include "analyzer.h"
+
+#include "pipelines.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Read-only view over an audio file already held in memory. libsndfile pulls
+// bytes straight out of `data` through the virtual I/O callbacks below, so no
+// temp file or intermediate copy is needed.
+struct MemoryAudioSource {
+    const unsigned char* data;
+    sf_count_t size;
+    sf_count_t position;
+};
+
+sf_count_t memoryGetLength(void* userData) {
+    return static_cast<MemoryAudioSource*>(userData)->size;
+}
+
+sf_count_t memorySeek(sf_count_t offset, int whence, void* userData) {
+    auto* source = static_cast<MemoryAudioSource*>(userData);
+    sf_count_t target = offset;
+    if (whence == SEEK_CUR) target = source->position + offset;
+    else if (whence == SEEK_END) target = source->size + offset;
+    if (target < 0 || target > source->size) return -1;
+    source->position = target;
+    return source->position;
+}
+
+sf_count_t memoryRead(void* ptr, sf_count_t count, void* userData) {
+    auto* source = static_cast<MemoryAudioSource*>(userData);
+    sf_count_t available = std::min(count, source->size - source->position);
+    if (available <= 0) return 0;
+    std::memcpy(ptr, source->data + source->position, static_cast<size_t>(available));
+    source->position += available;
+    return available;
+}
+
+sf_count_t memoryWrite(const void*, sf_count_t, void*) {
+    return 0;
+}
+
+sf_count_t memoryTell(void* userData) {
+    return static_cast<MemoryAudioSource*>(userData)->position;
+}
+
+// --- Peak candidates ---------------------------------------------------------
+// detectPeaks() first collects every local maximum above the threshold, 16
+// samples per step, then applies minGap to that much shorter list. A kernel
+// scans indices [begin, end), reads signal[begin - 1] to signal[end], and
+// returns the number of indices written to `out`.
+
+using CandidateKernel = size_t (*)(const float* signal, size_t begin, size_t end, float threshold, int64_t* out);
+
+constexpr size_t candidateChunk = 2048;  // indices scanned per candidate batch
+
+// Writes base + the position of each set bit, lowest first.
+inline size_t compactMask(uint32_t mask, int64_t base, int64_t* out) {
+    size_t count = 0;
+    while (mask) {
+        out[count++] = base + __builtin_ctz(mask);
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+size_t peakCandidatesScalar(const float* signal, size_t begin, size_t end, float threshold, int64_t* out) {
+    size_t count = 0;
+    for (size_t i = begin; i < end; ++i) {
+        out[count] = static_cast<int64_t>(i);
+        count += (signal[i] > signal[i - 1]) & (signal[i] > signal[i + 1]) & (signal[i] > threshold);
+    }
+    return count;
+}
+
+#if defined(__x86_64__)
+size_t peakCandidatesSse2(const float* signal, size_t begin, size_t end, float threshold, int64_t* out) {
+    const __m128 limit = _mm_set1_ps(threshold);
+    size_t count = 0, i = begin;
+    for (; i + 16 <= end; i += 16) {
+        uint32_t mask = 0;
+        for (int k = 0; k < 4; ++k) {
+            const float* p = signal + i + 4 * k;
+            __m128 centre = _mm_loadu_ps(p);
+            __m128 peak = _mm_and_ps(_mm_cmpgt_ps(centre, _mm_loadu_ps(p - 1)), _mm_cmpgt_ps(centre, _mm_loadu_ps(p + 1)));
+            mask |= uint32_t(_mm_movemask_ps(_mm_and_ps(peak, _mm_cmpgt_ps(centre, limit)))) << (4 * k);
+        }
+        count += compactMask(mask, static_cast<int64_t>(i), out + count);
+    }
+    return count + peakCandidatesScalar(signal, i, end, threshold, out + count);
+}
+
+__attribute__((target("avx"))) size_t peakCandidatesAvx(const float* signal, size_t begin, size_t end,
+                                                        float threshold, int64_t* out) {
+    const __m256 limit = _mm256_set1_ps(threshold);
+    size_t count = 0, i = begin;
+    for (; i + 16 <= end; i += 16) {
+        uint32_t mask = 0;
+        for (int k = 0; k < 2; ++k) {
+            const float* p = signal + i + 8 * k;
+            __m256 centre = _mm256_loadu_ps(p);
+            __m256 peak = _mm256_and_ps(_mm256_cmp_ps(centre, _mm256_loadu_ps(p - 1), _CMP_GT_OQ),
+                                        _mm256_cmp_ps(centre, _mm256_loadu_ps(p + 1), _CMP_GT_OQ));
+            peak = _mm256_and_ps(peak, _mm256_cmp_ps(centre, limit, _CMP_GT_OQ));
+            mask |= uint32_t(_mm256_movemask_ps(peak)) << (8 * k);
+        }
+        count += compactMask(mask, static_cast<int64_t>(i), out + count);
+    }
+    return count + peakCandidatesScalar(signal, i, end, threshold, out + count);
+}
+#elif defined(__aarch64__)
+size_t peakCandidatesNeon(const float* signal, size_t begin, size_t end, float threshold, int64_t* out) {
+    static const uint32_t laneBits[4] = {1, 2, 4, 8};
+    const uint32x4_t bits = vld1q_u32(laneBits);
+    const float32x4_t limit = vdupq_n_f32(threshold);
+    size_t count = 0, i = begin;
+    for (; i + 16 <= end; i += 16) {
+        uint32_t mask = 0;
+        for (int k = 0; k < 4; ++k) {
+            const float* p = signal + i + 4 * k;
+            float32x4_t centre = vld1q_f32(p);
+            uint32x4_t peak = vandq_u32(vcgtq_f32(centre, vld1q_f32(p - 1)), vcgtq_f32(centre, vld1q_f32(p + 1)));
+            peak = vandq_u32(peak, vcgtq_f32(centre, limit));
+            mask |= vaddvq_u32(vandq_u32(peak, bits)) << (4 * k);
+        }
+        count += compactMask(mask, static_cast<int64_t>(i), out + count);
+    }
+    return count + peakCandidatesScalar(signal, i, end, threshold, out + count);
+}
+#endif
+
+CandidateKernel selectCandidateKernel() {
+#if defined(__x86_64__)
+    return __builtin_cpu_supports("avx") ? peakCandidatesAvx : peakCandidatesSse2;
+#elif defined(__aarch64__)
+    return peakCandidatesNeon;
+#else
+    return peakCandidatesScalar;
+#endif
+}
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Appends the peaks among signal[begin, end) to `peaks`, and their refined
+// positions to `positions` unless it is null, where signal[0] is at sample
+// position `origin`.
+void appendPeaks(const float* signal, size_t begin, size_t end, int64_t origin, float threshold, int minGap,
+                 std::vector<int64_t>& peaks, std::vector<double>* positions) {
+    static const CandidateKernel findCandidates = selectCandidateKernel();
+    int64_t candidates[candidateChunk];
+    for (size_t from = begin; from < end; from += candidateChunk) {
+        size_t count = findCandidates(signal, from, std::min(end, from + candidateChunk), threshold, candidates);
+        for (size_t k = 0; k < count; ++k) {
+            // Keep a candidate only if it is far enough from the last kept peak
+            int64_t at = origin + candidates[k];
+            if (peaks.empty() || at - peaks.back() > minGap) {
+                peaks.push_back(at);
+                if (positions) {
+                    const float* s = signal + candidates[k];
+                    positions->push_back(static_cast<double>(at) + parabolicOffset(s[-1], s[0], s[1]));
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+void detectPeaks(const std::vector<float>& signal, float threshold, int minGap, std::vector<int64_t>& peaks,
+                 std::vector<double>& positions) {
+    TraceScope trace("detect peaks", MetricStage::Peaks);
+    peaks.clear();
+    positions.clear();
+    if (signal.size() < 3) return;
+    appendPeaks(signal.data(), 1, signal.size() - 1, 0, threshold, minGap, peaks, &positions);
+}
+
+void detectPeaks(const std::vector<float>& signal, float threshold, int minGap, std::vector<int64_t>& peaks) {
+    TraceScope trace("detect peaks", MetricStage::Peaks);
+    peaks.clear();
+    if (signal.size() < 3) return;
+    appendPeaks(signal.data(), 1, signal.size() - 1, 0, threshold, minGap, peaks, nullptr);
+}
+
+std::vector<int64_t> detectPeaks(const std::vector<float>& signal, float threshold, int minGap) {
+    std::vector<int64_t> peaks;
+    detectPeaks(signal, threshold, minGap, peaks);
+    return peaks;
+}
+
+float calculateBpm(const std::vector<int64_t>& peaks, int sampleRate) {
+    if (peaks.size() < 2) return 0.0f;
+
+    float totalTimeBetweenPeaks = 0.0f;
+    for (size_t i = 1; i < peaks.size(); ++i) {
+        float timeBetweenPeaks = static_cast<float>(peaks[i] - peaks[i - 1]) / sampleRate;
+        totalTimeBetweenPeaks += timeBetweenPeaks;
+    }
+
+    float avgTimeBetweenPeaks = totalTimeBetweenPeaks / (peaks.size() - 1);
+    float bpm = 60.0f / avgTimeBetweenPeaks;
+    return bpm;
+}
+
+float calculateBpm(const std::vector<double>& positions, int sampleRate) {
+    if (positions.size() < 2) return 0.0f;
+    // The intervals telescope, so their mean only needs the endpoints.
+    double meanInterval = (positions.back() - positions.front()) / (positions.size() - 1) / sampleRate;
+    return meanInterval > 0.0 ? static_cast<float>(60.0 / meanInterval) : 0.0f;
+}
+
+float parabolicOffset(float left, float center, float right) {
+    if (center < left || center < right) return 0.0f;
+    float denom = left - 2.0f * center + right;
+    if (denom >= 0.0f) return 0.0f;
+    return std::clamp(0.5f * (left - right) / denom, -0.5f, 0.5f);
+}
+
+void computeEnvelope(const std::vector<float>& mono, float smoothingFactor, std::vector<float>& envelope) {
+    TraceScope trace("envelope", MetricStage::Envelope);
+    envelope.resize(mono.size());
+    rectify(mono.data(), mono.size(), envelope.data());
+    smoothInPlace(envelope.data(), envelope.size(), smoothingFactor);
+}
+
+namespace {
+
+// Runs the smoothInPlace() recurrence down each column of `lanes`, starting
+// from `previous` and leaving the last row there.
+void smoothLanes(float (*lanes)[envelopeLanes], size_t frames, float smoothingFactor, float* previous) {
+#if defined(__x86_64__)
+    const __m128 a = _mm_set1_ps(smoothingFactor), b = _mm_set1_ps(1.0f - smoothingFactor);
+    const __m128 guard = _mm_set1_ps(denormalGuard);
+    __m128 low = _mm_loadu_ps(previous), high = _mm_loadu_ps(previous + 4);
+    for (size_t t = 0; t < frames; ++t) {
+        low = _mm_add_ps(_mm_mul_ps(a, _mm_add_ps(_mm_load_ps(lanes[t]), guard)), _mm_mul_ps(b, low));
+        high = _mm_add_ps(_mm_mul_ps(a, _mm_add_ps(_mm_load_ps(lanes[t] + 4), guard)), _mm_mul_ps(b, high));
+        _mm_store_ps(lanes[t], low);
+        _mm_store_ps(lanes[t] + 4, high);
+    }
+    _mm_storeu_ps(previous, low);
+    _mm_storeu_ps(previous + 4, high);
+#elif defined(__aarch64__)
+    const float32x4_t a = vdupq_n_f32(smoothingFactor), b = vdupq_n_f32(1.0f - smoothingFactor);
+    const float32x4_t guard = vdupq_n_f32(denormalGuard);
+    float32x4_t low = vld1q_f32(previous), high = vld1q_f32(previous + 4);
+    for (size_t t = 0; t < frames; ++t) {
+        low = vaddq_f32(vmulq_f32(a, vaddq_f32(vld1q_f32(lanes[t]), guard)), vmulq_f32(b, low));
+        high = vaddq_f32(vmulq_f32(a, vaddq_f32(vld1q_f32(lanes[t] + 4), guard)), vmulq_f32(b, high));
+        vst1q_f32(lanes[t], low);
+        vst1q_f32(lanes[t] + 4, high);
+    }
+    vst1q_f32(previous, low);
+    vst1q_f32(previous + 4, high);
+#else
+    for (size_t t = 0; t < frames; ++t) {
+        for (size_t l = 0; l < envelopeLanes; ++l) {
+            previous[l] = smoothingFactor * (lanes[t][l] + denormalGuard) + (1.0f - smoothingFactor) * previous[l];
+            lanes[t][l] = previous[l];
+        }
+    }
+#endif
+}
+
+} // namespace
+
+void computeEnvelopes(const float* const* mono, const size_t* lengths, size_t count, float smoothingFactor,
+                      float* const* envelope) {
+    TraceScope trace("envelope lanes", MetricStage::Envelope);
+    constexpr size_t tileFrames = 512;  // one tile of lanes is 16 KiB, well inside L1
+    constexpr size_t idle = std::numeric_limits<size_t>::max();
+    alignas(32) float lanes[tileFrames][envelopeLanes];
+    float previous[envelopeLanes] = {};
+    size_t signal[envelopeLanes], position[envelopeLanes];
+    size_t next = 0, active = 0;
+
+    // Starts the next signal in lane l. Its first value is kept as is and
+    // seeds the recurrence, so the lane continues from position 1.
+    auto start = [&](size_t l) {
+        signal[l] = idle;
+        while (next < count && signal[l] == idle) {
+            size_t i = next++;
+            if (lengths[i] == 0) continue;
+            envelope[i][0] = std::abs(mono[i][0]);
+            if (lengths[i] == 1) continue;
+            signal[l] = i;
+            previous[l] = envelope[i][0];
+            position[l] = 1;
+            ++active;
+        }
+    };
+    for (size_t l = 0; l < envelopeLanes; ++l) start(l);
+
+    // Once most lanes are idle a tile costs more than the scalar recurrence
+    // on the signals that are left.
+    while (active > 0 && (next < count || 2 * active >= envelopeLanes)) {
+        // Transpose in, rectified; lanes past the end of their signal hold zeros.
+        size_t valid[envelopeLanes], frames = 0;
+        for (size_t l = 0; l < envelopeLanes; ++l) {
+            valid[l] = signal[l] == idle ? 0 : std::min(tileFrames, lengths[signal[l]] - position[l]);
+            frames = std::max(frames, valid[l]);
+        }
+        if (*std::min_element(valid, valid + envelopeLanes) == frames) {
+            const float* in[envelopeLanes];
+            for (size_t l = 0; l < envelopeLanes; ++l) in[l] = mono[signal[l]] + position[l];
+            for (size_t t = 0; t < frames; ++t) {
+                for (size_t l = 0; l < envelopeLanes; ++l) lanes[t][l] = std::abs(in[l][t]);
+            }
+        } else {
+            for (size_t l = 0; l < envelopeLanes; ++l) {
+                const float* in = valid[l] ? mono[signal[l]] + position[l] : nullptr;
+                for (size_t t = 0; t < valid[l]; ++t) lanes[t][l] = std::abs(in[t]);
+                for (size_t t = valid[l]; t < frames; ++t) lanes[t][l] = 0.0f;
+            }
+        }
+
+        smoothLanes(lanes, frames, smoothingFactor, previous);
+
+        for (size_t l = 0; l < envelopeLanes; ++l) {
+            if (valid[l] == 0) continue;
+            float* out = envelope[signal[l]] + position[l];
+            for (size_t t = 0; t < valid[l]; ++t) out[t] = lanes[t][l];
+            position[l] += valid[l];
+            if (position[l] == lengths[signal[l]]) {
+                --active;
+                start(l);
+            }
+        }
+    }
+
+    for (size_t l = 0; l < envelopeLanes; ++l) {
+        if (signal[l] == idle || position[l] == lengths[signal[l]]) continue;
+        const float* in = mono[signal[l]];
+        float* out = envelope[signal[l]];
+        for (size_t t = position[l]; t < lengths[signal[l]]; ++t) {
+            previous[l] = smoothingFactor * (std::abs(in[t]) + denormalGuard) + (1.0f - smoothingFactor) * previous[l];
+            out[t] = previous[l];
+        }
+    }
+}
+
+namespace {
+
+// Goertzel kernels run the recurrence s = (x - s2) + coeff * s1 over
+// x[0, n) for goertzelLanes frequencies at once and leave the last two
+// states in s1, s2. Each vector of lanes is its own dependency chain, so
+// several are in flight per sample; x - s2 is off the critical path.
+
+using GoertzelKernel = void (*)(const float* x, size_t n, const float* coeff, float* s1, float* s2);
+
+#if defined(__x86_64__)
+void goertzelSse2(const float* x, size_t n, const float* coeff, float* s1, float* s2) {
+    constexpr size_t vectors = goertzelLanes / 4;
+    __m128 c[vectors], a[vectors], b[vectors];
+    for (size_t v = 0; v < vectors; ++v) {
+        c[v] = _mm_loadu_ps(coeff + 4 * v);
+        a[v] = b[v] = _mm_setzero_ps();
+    }
+    for (size_t t = 0; t < n; ++t) {
+        const __m128 in = _mm_set1_ps(x[t]);
+        for (size_t v = 0; v < vectors; ++v) {
+            __m128 next = _mm_add_ps(_mm_sub_ps(in, b[v]), _mm_mul_ps(c[v], a[v]));
+            b[v] = a[v];
+            a[v] = next;
+        }
+    }
+    for (size_t v = 0; v < vectors; ++v) {
+        _mm_storeu_ps(s1 + 4 * v, a[v]);
+        _mm_storeu_ps(s2 + 4 * v, b[v]);
+    }
+}
+
+__attribute__((target("avx"))) void goertzelAvx(const float* x, size_t n, const float* coeff, float* s1,
+                                                float* s2) {
+    constexpr size_t vectors = goertzelLanes / 8;
+    __m256 c[vectors], a[vectors], b[vectors];
+    for (size_t v = 0; v < vectors; ++v) {
+        c[v] = _mm256_loadu_ps(coeff + 8 * v);
+        a[v] = b[v] = _mm256_setzero_ps();
+    }
+    for (size_t t = 0; t < n; ++t) {
+        const __m256 in = _mm256_set1_ps(x[t]);
+        for (size_t v = 0; v < vectors; ++v) {
+            __m256 next = _mm256_add_ps(_mm256_sub_ps(in, b[v]), _mm256_mul_ps(c[v], a[v]));
+            b[v] = a[v];
+            a[v] = next;
+        }
+    }
+    for (size_t v = 0; v < vectors; ++v) {
+        _mm256_storeu_ps(s1 + 8 * v, a[v]);
+        _mm256_storeu_ps(s2 + 8 * v, b[v]);
+    }
+}
+#elif defined(__aarch64__)
+void goertzelNeon(const float* x, size_t n, const float* coeff, float* s1, float* s2) {
+    constexpr size_t vectors = goertzelLanes / 4;
+    float32x4_t c[vectors], a[vectors], b[vectors];
+    for (size_t v = 0; v < vectors; ++v) {
+        c[v] = vld1q_f32(coeff + 4 * v);
+        a[v] = b[v] = vdupq_n_f32(0.0f);
+    }
+    for (size_t t = 0; t < n; ++t) {
+        const float32x4_t in = vdupq_n_f32(x[t]);
+        for (size_t v = 0; v < vectors; ++v) {
+            float32x4_t next = vaddq_f32(vsubq_f32(in, b[v]), vmulq_f32(c[v], a[v]));
+            b[v] = a[v];
+            a[v] = next;
+        }
+    }
+    for (size_t v = 0; v < vectors; ++v) {
+        vst1q_f32(s1 + 4 * v, a[v]);
+        vst1q_f32(s2 + 4 * v, b[v]);
+    }
+}
+#else
+void goertzelScalar(const float* x, size_t n, const float* coeff, float* s1, float* s2) {
+    for (size_t l = 0; l < goertzelLanes; ++l) s1[l] = s2[l] = 0.0f;
+    for (size_t t = 0; t < n; ++t) {
+        for (size_t l = 0; l < goertzelLanes; ++l) {
+            float next = (x[t] - s2[l]) + coeff[l] * s1[l];
+            s2[l] = s1[l];
+            s1[l] = next;
+        }
+    }
+}
+#endif
+
+GoertzelKernel selectGoertzelKernel() {
+#if defined(__x86_64__)
+    return __builtin_cpu_supports("avx") ? goertzelAvx : goertzelSse2;
+#elif defined(__aarch64__)
+    return goertzelNeon;
+#else
+    return goertzelScalar;
+#endif
+}
+
+} // namespace
+
+void goertzelPower(const float* x, size_t n, const float* omegas, size_t count, float* power) {
+    static const GoertzelKernel recurrence = selectGoertzelKernel();
+    for (size_t from = 0; from < count; from += goertzelLanes) {
+        size_t width = std::min(goertzelLanes, count - from);
+        // Idle lanes repeat the last frequency and are discarded.
+        float coeff[goertzelLanes], s1[goertzelLanes], s2[goertzelLanes];
+        for (size_t l = 0; l < goertzelLanes; ++l) {
+            coeff[l] = 2.0f * std::cos(omegas[from + std::min(l, width - 1)]);
+        }
+        recurrence(x, n, coeff, s1, s2);
+        for (size_t l = 0; l < width; ++l) {
+            power[from + l] = s1[l] * s1[l] + s2[l] * s2[l] - coeff[l] * s1[l] * s2[l];
+        }
+    }
+}
+
+PeakStream::PeakStream(float smoothingFactor, float threshold, int minGap, std::vector<float>& tile,
+                       std::vector<int64_t>& peaks, std::vector<double>& positions)
+    : smoothingFactor_(smoothingFactor), threshold_(threshold), minGap_(minGap), tile_(tile), peaks_(peaks),
+      positions_(positions) {
+    peaks_.clear();
+    positions_.clear();
+}
+
+void PeakStream::push(const float* mono, size_t count) {
+    if (count == 0) return;
+    tile_.resize(carried_ + count);
+    float* values = tile_.data();
+    rectify(mono, count, values + carried_);
+    // Smoothing continues from the last carried envelope value.
+    if (carried_ > 0) smoothInPlace(values + carried_ - 1, count + 1, smoothingFactor_);
+    else smoothInPlace(values, count, smoothingFactor_);
+
+    // Every index but the last now has both neighbours. The last one is
+    // judged with the next tile, so keep it and its left neighbour.
+    size_t size = carried_ + count;
+    if (size >= 3) appendPeaks(values, 1, size - 1, position_, threshold_, minGap_, peaks_, &positions_);
+    size_t keep = std::min<size_t>(2, size);
+    std::copy(values + size - keep, values + size, values);
+    position_ += static_cast<int64_t>(size - keep);
+    carried_ = keep;
+}
+
+void downmixToMono(const float* interleaved, size_t frames, size_t channels, float* mono) {
+    if (channels > 1) {
+        for (size_t i = 0; i < frames; ++i) {
+            mono[i] = (interleaved[i * channels] + interleaved[i * channels + 1]) / 2.0f;
+        }
+    } else {
+        std::copy(interleaved, interleaved + frames, mono);
+    }
+}
+
+void rectify(const float* in, size_t count, float* out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = std::abs(in[i]);
+    }
+}
+
+void smoothInPlace(float* values, size_t count, float smoothingFactor) {
+    // The guard is added to the input, off the recurrence's critical path.
+    for (size_t i = 1; i < count; ++i) {
+        values[i] = smoothingFactor * (values[i] + denormalGuard) + (1.0f - smoothingFactor) * values[i - 1];
+    }
+}
+
+DenormalScope::DenormalScope(bool enable) : active_(enable) {
+    if (!active_) return;
+#if defined(__x86_64__)
+    saved_ = _mm_getcsr();
+    _mm_setcsr(static_cast<unsigned>(saved_) | 0x8040);  // FTZ (bit 15) | DAZ (bit 6)
+#elif defined(__aarch64__)
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(saved_));
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(saved_ | (uint64_t(1) << 24)));  // FZ
+#else
+    active_ = false;
+#endif
+}
+
+DenormalScope::~DenormalScope() {
+    if (!active_) return;
+#if defined(__x86_64__)
+    _mm_setcsr(static_cast<unsigned>(saved_));
+#elif defined(__aarch64__)
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(saved_));
+#endif
+}
+
+bool parsePreset(const std::string& name, AnalysisPreset& preset) {
+    if (name == "legacy") preset = AnalysisPreset::Legacy;
+    else if (name == "fast") preset = AnalysisPreset::Fast;
+    else if (name == "balanced") preset = AnalysisPreset::Balanced;
+    else if (name == "accurate") preset = AnalysisPreset::Accurate;
+    else return false;
+    return true;
+}
+
+const char* presetName(AnalysisPreset preset) {
+    switch (preset) {
+    case AnalysisPreset::Legacy: return "legacy";
+    case AnalysisPreset::Fast: return "fast";
+    case AnalysisPreset::Balanced: return "balanced";
+    case AnalysisPreset::Accurate: return "accurate";
+    }
+    return "unknown";
+}
+
+bool parseTempoPrior(const std::string& text, TempoPrior& prior) {
+    struct Genre {
+        const char* name;
+        float minBpm, maxBpm;
+    };
+    static const Genre genres[] = {
+        {"house", 118.0f, 130.0f},  {"techno", 125.0f, 150.0f}, {"trance", 130.0f, 145.0f},
+        {"dnb", 160.0f, 180.0f},    {"hiphop", 80.0f, 105.0f},  {"dubstep", 135.0f, 145.0f},
+    };
+    if (text == "none") {
+        prior = TempoPrior{};
+        return true;
+    }
+    for (const Genre& genre : genres) {
+        if (text == genre.name) {
+            prior = TempoPrior{genre.minBpm, genre.maxBpm};
+            return true;
+        }
+    }
+    size_t colon = text.find(':');
+    if (colon == std::string::npos) return false;
+    char* end = nullptr;
+    float minBpm = std::strtof(text.c_str(), &end);
+    if (end != text.c_str() + colon) return false;
+    float maxBpm = std::strtof(text.c_str() + colon + 1, &end);
+    if (*end != '\0' || end == text.c_str() + colon + 1 || !(minBpm > 0.0f) || !(maxBpm >= minBpm)) return false;
+    prior = TempoPrior{minBpm, maxBpm};
+    return true;
+}
+
+Analyzer::Analyzer(AnalyzerConfig config) : config_(config) {}
+
+uint64_t AnalyzerState::scratchBytes() const {
+    return (samples.capacity() + envelope.capacity() + onset.capacity() + scratch.capacity() + block.capacity()) *
+               sizeof(float) +
+           peaks.capacity() * sizeof(int64_t) + hopIndices.capacity() * sizeof(int) +
+           positions.capacity() * sizeof(double);
+}
+
+bool Analyzer::analyzesWhileDecoding() const {
+    return config_.tileFrames > 0 && config_.preset == AnalysisPreset::Legacy && !config_.computeOverview;
+}
+
+AnalysisResult Analyzer::analyzeFile(const std::string& path, AnalyzerState& state) const {
+    DenormalScope denormals(config_.flushDenormals);
+    AllocationScope allocations(state.scratchBytes());
+    const bool streamed = analyzesWhileDecoding();
+    AnalysisResult result = decodePath(path, state, streamed ? DecodeTarget::Tiles : DecodeTarget::Samples);
+    if (result.ok && !streamed) analyzeDecoded(state, result);
+    result.memory = allocations.finish();
+    return result;
+}
+
+AnalysisResult Analyzer::decodeFile(const std::string& path, AnalyzerState& state) const {
+    return decodePath(path, state, DecodeTarget::Samples);
+}
+
+AnalysisResult Analyzer::decodePath(const std::string& path, AnalyzerState& state, DecodeTarget target) const {
+    std::error_code ec;
+    uintmax_t inputBytes = 0;
+    SF_INFO sfinfo = {};
+    SNDFILE* file = nullptr;
+    {
+        TraceScope trace("open");
+        inputBytes = fs::file_size(path, ec);
+        if (!ec) file = sf_open(path.c_str(), SFM_READ, &sfinfo);
+    }
+    if (ec) {
+        AnalysisResult result;
+        result.source = path;
+        result.error = "File not found";
+        return result;
+    }
+    if (!file) {
+        AnalysisResult result;
+        result.source = path;
+        result.error = std::string("Error opening file: ") + sf_strerror(file);
+        return result;
+    }
+
+    AnalysisResult result = decodeHandle(file, sfinfo, path, state, target);
+    result.inputBytes = inputBytes;
+    return result;
+}
+
+AnalysisResult Analyzer::analyzeMemory(const void* data, size_t size, const std::string& label,
+                                       AnalyzerState& state) const {
+    MemoryAudioSource source{static_cast<const unsigned char*>(data), static_cast<sf_count_t>(size), 0};
+    SF_VIRTUAL_IO io{memoryGetLength, memorySeek, memoryRead, memoryWrite, memoryTell};
+    AnalysisResult result = analyzeVirtual(io, &source, label, state);
+    result.inputBytes = size;
+    return result;
+}
+
+AnalysisResult Analyzer::analyzeVirtual(SF_VIRTUAL_IO& io, void* userData, const std::string& label,
+                                        AnalyzerState& state) const {
+    DenormalScope denormals(config_.flushDenormals);
+    AllocationScope allocations(state.scratchBytes());
+    SF_INFO sfinfo = {};
+    SNDFILE* file = nullptr;
+    {
+        TraceScope trace("open");
+        file = sf_open_virtual(&io, SFM_READ, &sfinfo, userData);
+    }
+    if (!file) {
+        AnalysisResult result;
+        result.source = label;
+        result.error = std::string("Error opening stream: ") + sf_strerror(file);
+        return result;
+    }
+
+    const bool streamed = analyzesWhileDecoding();
+    AnalysisResult result =
+        decodeHandle(file, sfinfo, label, state, streamed ? DecodeTarget::Tiles : DecodeTarget::Samples);
+    if (result.ok && !streamed) analyzeDecoded(state, result);
+    result.memory = allocations.finish();
+    return result;
+}
+
+void Analyzer::analyzeBatch(const std::vector<std::string>& paths, AnalyzerState& state,
+                            std::vector<AnalysisResult>& results) const {
+    results.clear();
+    if (config_.preset != AnalysisPreset::Legacy || config_.tileFrames > 0 || config_.computeOverview) {
+        for (const std::string& path : paths) {
+            TraceScope trace("file", &path);
+            results.push_back(analyzeFile(path, state));
+        }
+        return;
+    }
+    DenormalScope denormals(config_.flushDenormals);
+
+    // Decode every file back to back into one arena. Each file is charged its
+    // own decode and stages plus an equal part of the shared envelope stage,
+    // like its time. Its decode and stages are traced as separate per-file
+    // scopes; the shared stage is only traced per batch.
+    std::vector<size_t> offsets;
+    offsets.reserve(paths.size() + 1);
+    state.samples.clear();
+    for (const std::string& path : paths) {
+        TraceScope trace("file decode", &path);
+        AllocationScope allocations(state.scratchBytes());
+        offsets.push_back(state.samples.size());
+        results.push_back(decodePath(path, state, DecodeTarget::AppendSamples));
+        results.back().memory = allocations.finish();
+    }
+    offsets.push_back(state.samples.size());
+
+    TraceScope trace("analyze batch");
+    auto start = Clock::now();
+    AllocationScope sharedAllocations(state.scratchBytes());
+    state.envelope.resize(state.samples.size());
+    // Longest first, so no lane is left with a long file at the end.
+    std::vector<size_t> order;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (results[i].ok) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(),
+              [&](size_t a, size_t b) { return offsets[a + 1] - offsets[a] > offsets[b + 1] - offsets[b]; });
+    std::vector<const float*> mono;
+    std::vector<float*> envelope;
+    std::vector<size_t> lengths;
+    for (size_t i : order) {
+        mono.push_back(state.samples.data() + offsets[i]);
+        envelope.push_back(state.envelope.data() + offsets[i]);
+        lengths.push_back(offsets[i + 1] - offsets[i]);
+    }
+    computeEnvelopes(mono.data(), lengths.data(), order.size(), config_.smoothingFactor, envelope.data());
+    const size_t decoded = order.size();
+    const FileMemory shared = sharedAllocations.finish();
+
+    for (size_t i = 0; i < paths.size(); ++i) {
+        AnalysisResult& result = results[i];
+        if (!result.ok) continue;
+        if (state.blockHook) state.blockHook();
+        TraceScope trace("file stages", &paths[i]);
+        AllocationScope allocations(state.scratchBytes());
+        size_t length = offsets[i + 1] - offsets[i];
+        state.peaks.clear();
+        state.positions.clear();
+        if (length >= 3) {
+            TraceScope trace("detect peaks", MetricStage::Peaks);
+            appendPeaks(state.envelope.data() + offsets[i], 1, length - 1, 0, config_.threshold, config_.minGap,
+                        state.peaks, &state.positions);
+        }
+        Pipeline<AnalysisPreset::Legacy>::finish(config_, state, result);
+        if (result.bpm > 0.0f) result.beatPeriodSeconds = 60.0 / result.bpm;
+
+        FileMemory stages = allocations.finish();
+        FileMemory& memory = result.memory;
+        memory.allocatedBytes += shared.allocatedBytes / decoded + stages.allocatedBytes;
+        memory.allocations += shared.allocations / decoded + stages.allocations;
+        memory.peakLiveBytes = std::max({memory.peakLiveBytes, shared.peakLiveBytes, stages.peakLiveBytes});
+        memory.residentBytes = stages.residentBytes;
+    }
+
+    // The stages are shared, so each file gets an equal part of their time.
+    double seconds = secondsSince(start);
+    for (AnalysisResult& result : results) {
+        if (result.ok) result.analysisSeconds = seconds / double(decoded);
+    }
+}
+
+// Reads all frames from an already opened handle into state.samples as mono
+// audio and closes the handle. With DecodeTarget::Tiles, each tile is instead
+// downmixed into state.samples and fed to the Legacy stages while it is in cache.
+AnalysisResult Analyzer::decodeHandle(SNDFILE* file, const SF_INFO& sfinfo, const std::string& label,
+                                      AnalyzerState& state, DecodeTarget target) const {
+    TraceScope trace("decode");
+    auto start = Clock::now();
+    AnalysisResult result;
+    result.source = label;
+    result.sampleRate = sfinfo.samplerate;
+    result.channels = sfinfo.channels;
+    result.frames = sfinfo.frames;
+
+    // Nothing below may run on a header with no (or negative) frames or
+    // channels: the block clamp and the size checks divide by them.
+    if (sfinfo.frames <= 0 || sfinfo.channels <= 0) {
+        result.error = "Invalid file (frames or channels is zero)";
+        sf_close(file);
+        return result;
+    }
+
+    // Decode block by block, downmixing straight into the mono buffer, so the
+    // full interleaved file is never held in memory. The block never exceeds
+    // the file, and every size is checked before it is computed.
+    const sf_count_t blockFrames = std::clamp<sf_count_t>(config_.blockFrames, 1, sfinfo.frames);
+    const size_t channels = static_cast<size_t>(sfinfo.channels);
+    std::vector<float>& samples = state.samples;
+    std::vector<float>& block = state.block;
+    const bool analyze = target == DecodeTarget::Tiles;
+    const size_t base = target == DecodeTarget::AppendSamples ? samples.size() : 0;
+    const uint64_t hopLimit = uint64_t(std::numeric_limits<int>::max()) * uint64_t(std::max(1, config_.hopSize));
+    if (uint64_t(sfinfo.frames) > samples.max_size() - base ||
+        uint64_t(blockFrames) > block.max_size() / channels ||
+        (config_.preset != AnalysisPreset::Legacy && uint64_t(sfinfo.frames) > hopLimit)) {
+        result.error = "File too long to analyze (" + std::to_string(sfinfo.frames) + " frames)";
+        sf_close(file);
+        return result;
+    }
+    samples.resize(analyze ? std::min<size_t>(config_.tileFrames, sfinfo.frames) : base + sfinfo.frames);
+    block.resize(blockFrames * channels);
+    PeakStream stream(config_.smoothingFactor, config_.threshold, config_.minGap, state.envelope, state.peaks,
+                      state.positions);
+    double tileSeconds = 0.0;
+
+    for (sf_count_t done = 0; done < sfinfo.frames;) {
+        sf_count_t want = std::min(blockFrames, sfinfo.frames - done);
+        sf_count_t got = 0;
+        {
+            TraceScope trace("read");
+            got = sf_readf_float(file, block.data(), want);
+        }
+        if (got != want) {
+            result.error = "Error reading samples";
+            sf_close(file);
+            if (target == DecodeTarget::AppendSamples) samples.resize(base);
+            return result;
+        }
+
+        if (analyze) {
+            TraceScope trace("tiles");
+            auto tileStart = Clock::now();
+            for (size_t at = 0; at < static_cast<size_t>(want); at += samples.size()) {
+                size_t count = std::min(samples.size(), static_cast<size_t>(want) - at);
+                downmixToMono(block.data() + at * channels, count, channels, samples.data());
+                stream.push(samples.data(), count);
+            }
+            tileSeconds += secondsSince(tileStart);
+        } else {
+            TraceScope trace("downmix");
+            downmixToMono(block.data(), static_cast<size_t>(want), channels, samples.data() + base + done);
+        }
+        done += want;
+
+        if (state.blockHook) state.blockHook();
+    }
+    sf_close(file);
+
+    result.ok = true;
+    if (analyze) {
+        Pipeline<AnalysisPreset::Legacy>::finish(config_, state, result);
+        if (result.bpm > 0.0f) result.beatPeriodSeconds = 60.0 / result.bpm;
+        result.analysisSeconds = tileSeconds;
+    }
+    result.decodeSeconds = secondsSince(start) - tileSeconds;
+    return result;
+}
+
+void Analyzer::analyzeDecoded(AnalyzerState& state, AnalysisResult& result) const {
+    DenormalScope denormals(config_.flushDenormals);
+    TraceScope trace("analyze");
+    auto start = Clock::now();
+    switch (config_.preset) {
+    case AnalysisPreset::Legacy:
+        if (config_.tileFrames > 0) Pipeline<AnalysisPreset::Legacy>::runTiled(config_, state, result);
+        else Pipeline<AnalysisPreset::Legacy>::run(config_, state, result);
+        break;
+    case AnalysisPreset::Fast: Pipeline<AnalysisPreset::Fast>::run(config_, state, result); break;
+    case AnalysisPreset::Balanced: Pipeline<AnalysisPreset::Balanced>::run(config_, state, result); break;
+    case AnalysisPreset::Accurate: Pipeline<AnalysisPreset::Accurate>::run(config_, state, result); break;
+    }
+    if (result.bpm > 0.0f) result.beatPeriodSeconds = 60.0 / result.bpm;
+
+    if (config_.computeOverview) {
+        TraceScope trace("overview");
+        const std::vector<float>& samples = state.samples;
+        for (size_t tile = 0; tile < overviewTileCount; ++tile) {
+            size_t begin = tile * samples.size() / overviewTileCount;
+            size_t end = (tile + 1) * samples.size() / overviewTileCount;
+            float peak = 0.0f;
+            for (size_t i = begin; i < end; ++i) peak = std::max(peak, std::abs(samples[i]));
+            result.overview[tile] = static_cast<uint8_t>(std::min(1.0f, peak) * 255.0f + 0.5f);
+        }
+    }
+    result.analysisSeconds = secondsSince(start);
+}
+
+void Analyzer::computeOnset(AnalyzerState& state, AnalysisResult& result) const {
+    DenormalScope denormals(config_.flushDenormals);
+    TraceScope trace("onset");
+    auto start = Clock::now();
+    switch (config_.preset) {
+    case AnalysisPreset::Legacy: break;
+    case AnalysisPreset::Fast: Pipeline<AnalysisPreset::Fast>::onset(config_, state, result); break;
+    case AnalysisPreset::Balanced: Pipeline<AnalysisPreset::Balanced>::onset(config_, state, result); break;
+    case AnalysisPreset::Accurate: Pipeline<AnalysisPreset::Accurate>::onset(config_, state, result); break;
+    }
+    result.analysisSeconds = secondsSince(start);
+}
+
+void Analyzer::estimateTempo(AnalyzerState& state, AnalysisResult& result) const {
+    DenormalScope denormals(config_.flushDenormals);
+    auto start = Clock::now();
+    switch (config_.preset) {
+    case AnalysisPreset::Legacy:
+        if (config_.tileFrames > 0) Pipeline<AnalysisPreset::Legacy>::runTiled(config_, state, result);
+        else Pipeline<AnalysisPreset::Legacy>::run(config_, state, result);
+        break;
+    case AnalysisPreset::Fast: Pipeline<AnalysisPreset::Fast>::tempo(config_, state, result); break;
+    case AnalysisPreset::Balanced: Pipeline<AnalysisPreset::Balanced>::tempo(config_, state, result); break;
+    case AnalysisPreset::Accurate: Pipeline<AnalysisPreset::Accurate>::tempo(config_, state, result); break;
+    }
+    if (result.bpm > 0.0f) result.beatPeriodSeconds = 60.0 / result.bpm;
+    result.analysisSeconds = secondsSince(start);
+}
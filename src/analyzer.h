@@ -0,0 +1,284 @@
+#pragma once
+
+#include <sndfile.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "memory_stats.h"
+
+// Analysis pipelines, from the original peak picker to the slowest and most
+// accurate. Each is compiled as its own Pipeline<> specialization.
+enum class AnalysisPreset {
+    Legacy,    // smoothed envelope + peak picking + mean inter-peak interval
+    Fast,      // decimated envelope + inter-onset interval histogram
+    Balanced,  // log-energy flux + autocorrelation
+    Accurate,  // multi-band flux + autocorrelation + beat tracking
+};
+
+// Tempo range expected for a genre, e.g. 118-130 BPM for house. Onset-based
+// presets weight candidate tempos by it: fully inside the range, falling off
+// by octaves of distance outside. An empty range keeps the general bias
+// towards 120 BPM.
+struct TempoPrior {
+    float minBpm = 0.0f;
+    float maxBpm = 0.0f;
+};
+
+// Accepts a genre (house, techno, trance, dnb, hiphop, dubstep), MIN:MAX, or
+// "none" for the empty prior.
+bool parseTempoPrior(const std::string& text, TempoPrior& prior);
+
+// Tunable parameters for the BPM pipeline. Defaults match the values the
+// original command-line tool used.
+struct AnalyzerConfig {
+    float threshold = 0.05f;       // minimum envelope level for a peak
+    int minGap = 500;              // minimum distance between peaks, in samples
+    float smoothingFactor = 0.1f;  // one-pole smoothing coefficient
+    float bpmDivisor = 35.0f;      // scale applied to calculateBpm() output (Legacy only)
+
+    AnalysisPreset preset = AnalysisPreset::Legacy;
+    int hopSize = 512;             // onset frame hop, in samples (non-Legacy presets)
+    float minBpm = 60.0f;          // tempo search range (non-Legacy presets)
+    float maxBpm = 200.0f;
+    TempoPrior tempoPrior;         // octave-error correction (non-Legacy presets)
+
+    sf_count_t blockFrames = 65536;  // frames decoded per read; blockHook runs between blocks
+    bool computeOverview = false;    // fill AnalysisResult::overview
+
+    // Legacy only: when > 0, the envelope and peak picking run one tile of
+    // this many frames at a time (see PeakStream) instead of as whole-file
+    // passes. analyzeFile() and analyzeVirtual() then also downmix each tile
+    // as it is decoded and never store the mono audio, unless computeOverview
+    // needs it. 32768 frames (128 KiB) stays in L2 on current CPUs.
+    size_t tileFrames = 0;
+
+    // Run the analysis with flush-to-zero and denormals-are-zero set on the
+    // calling thread (see DenormalScope). Only values below ~1e-38 change.
+    bool flushDenormals = true;
+};
+
+// Returns false if `name` is not one of legacy, fast, balanced, accurate.
+bool parsePreset(const std::string& name, AnalysisPreset& preset);
+const char* presetName(AnalysisPreset preset);
+
+// A tempo weighed by the octave-error resolver. Scores are relative to the
+// chosen candidate, which scores 1.
+struct TempoCandidate {
+    float bpm = 0.0f;
+    float score = 0.0f;
+};
+
+// The resolver weighs 1x, 2x, 0.5x, 1.5x and 2/3x of the estimated tempo.
+constexpr size_t tempoCandidateCount = 5;
+
+// Number of tiles in the waveform overview, one peak level per tile.
+constexpr size_t overviewTileCount = 256;
+
+struct AnalysisResult {
+    std::string source;
+    bool ok = false;
+    std::string error;
+    int sampleRate = 0;
+    int channels = 0;
+    sf_count_t frames = 0;
+    size_t peakCount = 0;          // peaks, onsets or beats, depending on the preset
+    float bpm = 0.0f;
+
+    // Beat grid reference: position of the first detected beat and the beat
+    // period implied by `bpm`. Zero when unknown.
+    double firstBeatSeconds = 0.0;
+    double beatPeriodSeconds = 0.0;
+
+    // Alternatives to `bpm` from the octave-error resolver, best first; unused
+    // entries have bpm 0. The first is the tempo the resolver chose, before
+    // beat tracking and refinement. Empty for the Legacy preset.
+    std::array<TempoCandidate, tempoCandidateCount> tempoCandidates{};
+
+    // Encoded input size and time spent in each stage, for metrics.
+    uint64_t inputBytes = 0;
+    double decodeSeconds = 0.0;
+    double analysisSeconds = 0.0;
+
+    // Heap use of this analysis on the worker that ran it. Filled by
+    // analyzeFile(), analyzeMemory(), analyzeVirtual() and analyzeBatch().
+    FileMemory memory;
+
+    // Peak level of each tile of the mono signal, 0-255. Only filled when
+    // AnalyzerConfig::computeOverview is set.
+    std::array<uint8_t, overviewTileCount> overview{};
+};
+
+// Scratch buffers reused between calls so repeated analyses do not reallocate.
+// Keep one per worker thread; a state must not be shared by concurrent calls.
+struct AnalyzerState {
+    std::vector<float> samples;
+    std::vector<float> envelope;
+    std::vector<int64_t> peaks;  // sample positions; 64-bit as hours at 192 kHz exceed INT_MAX
+    std::vector<int> hopIndices; // onset or beat positions, in hops
+    std::vector<double> positions; // peaks or hopIndices refined to sub-sample (sub-hop) precision
+    std::vector<float> onset;    // onset strength at hop resolution
+    std::vector<float> scratch;  // per-pipeline working space
+    std::vector<float> block;    // interleaved decode buffer, one block long
+
+    // Capacity held by the buffers above.
+    uint64_t scratchBytes() const;
+
+    // Called after every decoded block and between analysis stages.
+    // Schedulers use it as a preemption point to run urgent work before
+    // resuming this analysis.
+    std::function<void()> blockHook;
+};
+
+// Stateless apart from its configuration, so a single Analyzer can be shared
+// by any number of threads as long as each passes its own AnalyzerState.
+class Analyzer {
+public:
+    explicit Analyzer(AnalyzerConfig config = {});
+
+    const AnalyzerConfig& config() const { return config_; }
+
+    AnalysisResult analyzeFile(const std::string& path, AnalyzerState& state) const;
+
+    // Decodes and downmixes `path` into state.samples without running the DSP
+    // stages, so the same audio can be analyzed repeatedly.
+    AnalysisResult decodeFile(const std::string& path, AnalyzerState& state) const;
+
+    // Runs envelope, peak picking and tempo estimation over the mono audio in
+    // state.samples, filling in the peak count and BPM of `result`.
+    void analyzeDecoded(AnalyzerState& state, AnalysisResult& result) const;
+
+    // analyzeDecoded() in two halves, so a parameter sweep can compute the
+    // onset envelope once and estimate the tempo under many configurations.
+    // computeOnset() fills state.onset from state.samples; estimateTempo()
+    // runs the tempo stages over it and leaves it unchanged, so any Analyzer
+    // with the same preset and hopSize may follow. Each sets
+    // result.analysisSeconds to its own time. For Legacy, computeOnset() does
+    // nothing and estimateTempo() runs the whole pipeline.
+    void computeOnset(AnalyzerState& state, AnalysisResult& result) const;
+    void estimateTempo(AnalyzerState& state, AnalysisResult& result) const;
+
+    // Decodes an encoded file (WAV, FLAC, ...) held in memory without copying
+    // it or writing it to disk.
+    AnalysisResult analyzeMemory(const void* data, size_t size, const std::string& label,
+                                 AnalyzerState& state) const;
+
+    // Decodes through caller-supplied libsndfile virtual I/O callbacks. `io`
+    // and `userData` must stay valid until the call returns.
+    AnalysisResult analyzeVirtual(SF_VIRTUAL_IO& io, void* userData, const std::string& label,
+                                  AnalyzerState& state) const;
+
+    // Analyzes many short files as one task, filling one result per path in
+    // order. Legacy files are decoded back to back into state.samples and
+    // their envelopes computed across files (see computeEnvelopes()); other
+    // configurations analyze file by file. The shared envelope stage's time
+    // and allocations are split evenly over the decoded files.
+    void analyzeBatch(const std::vector<std::string>& paths, AnalyzerState& state,
+                      std::vector<AnalysisResult>& results) const;
+
+private:
+    enum class DecodeTarget {
+        Samples,        // replace state.samples with the file
+        AppendSamples,  // append the file to state.samples
+        Tiles,          // run the Legacy stages per tile; state.samples holds one tile
+    };
+
+    // True when decoding feeds tiles straight into the Legacy stages.
+    bool analyzesWhileDecoding() const;
+
+    AnalysisResult decodePath(const std::string& path, AnalyzerState& state, DecodeTarget target) const;
+    AnalysisResult decodeHandle(SNDFILE* file, const SF_INFO& sfinfo, const std::string& label,
+                                AnalyzerState& state, DecodeTarget target) const;
+
+    AnalyzerConfig config_;
+};
+
+std::vector<int64_t> detectPeaks(const std::vector<float>& signal, float threshold, int minGap);
+// Same as above but fills `peaks` so callers can reuse its capacity.
+void detectPeaks(const std::vector<float>& signal, float threshold, int minGap, std::vector<int64_t>& peaks);
+// Also fills `positions` with each peak refined by parabolicOffset().
+void detectPeaks(const std::vector<float>& signal, float threshold, int minGap, std::vector<int64_t>& peaks,
+                 std::vector<double>& positions);
+// Rectifies `mono` and applies one-pole smoothing into `envelope`.
+void computeEnvelope(const std::vector<float>& mono, float smoothingFactor, std::vector<float>& envelope);
+float calculateBpm(const std::vector<int64_t>& peaks, int sampleRate);
+// Same from refined peak positions, in double precision.
+float calculateBpm(const std::vector<double>& positions, int sampleRate);
+
+// Offset in [-0.5, 0.5] of the vertex of the parabola through three equally
+// spaced values, relative to the middle one. 0 unless the middle value is a
+// maximum, so it can be applied to any picked index.
+float parabolicOffset(float left, float center, float right);
+
+// computeEnvelope() for `count` signals, envelopeLanes at a time. The
+// signals are transposed into lanes (structure of arrays) so rectify and
+// smoothing run across files as SIMD lanes, which hides the latency of the
+// smoothing recurrence that bounds the single-signal loop. A lane whose
+// signal ends takes the next one, so lengths need not match; longest first
+// keeps the lanes busy to the end. envelope[i] receives lengths[i] values,
+// identical to computeEnvelope() on mono[i].
+constexpr size_t envelopeLanes = 8;
+void computeEnvelopes(const float* const* mono, const size_t* lengths, size_t count, float smoothingFactor,
+                      float* const* envelope);
+
+// Power of the DFT of x[0, n) at each of `count` angular frequencies, in
+// radians per sample, by the Goertzel recurrence: n multiply-adds per
+// frequency. The recurrence is serial in x, so goertzelLanes frequencies run
+// side by side as SIMD lanes.
+constexpr size_t goertzelLanes = 16;
+void goertzelPower(const float* x, size_t n, const float* omegas, size_t count, float* power);
+
+// computeEnvelope() followed by detectPeaks(), run incrementally over
+// consecutive tiles of mono audio. The smoothing state, the last two envelope
+// values and the last kept peak carry over between tiles, so the peaks are
+// identical to the whole-signal passes while only one tile of envelope is
+// ever held. `tile` is the working buffer; `peaks` and `positions` are
+// cleared and filled as by detectPeaks().
+class PeakStream {
+public:
+    PeakStream(float smoothingFactor, float threshold, int minGap, std::vector<float>& tile,
+               std::vector<int64_t>& peaks, std::vector<double>& positions);
+
+    void push(const float* mono, size_t count);
+
+private:
+    float smoothingFactor_;
+    float threshold_;
+    int minGap_;
+    std::vector<float>& tile_;  // carried envelope values, then the current tile
+    std::vector<int64_t>& peaks_;
+    std::vector<double>& positions_;
+    size_t carried_ = 0;
+    int64_t position_ = 0;      // sample position of tile_[0]
+};
+
+// The loops behind decoding and computeEnvelope(), exposed so they can be
+// benchmarked in isolation. downmixToMono averages the first two channels.
+void downmixToMono(const float* interleaved, size_t frames, size_t channels, float* mono);
+void rectify(const float* in, size_t count, float* out);
+void smoothInPlace(float* values, size_t count, float smoothingFactor);
+
+// Added to the input of the IIR stages. In digital silence their state then
+// settles on a small normal value instead of decaying into subnormals, which
+// x86 handles in microcode at ~100x the cost when FTZ is off. It is below half
+// an ulp of any 24-bit sample, so it only changes results near silence.
+constexpr float denormalGuard = 1e-15f;
+
+// Sets flush-to-zero and denormals-are-zero (FZ on AArch64) on the calling
+// thread and restores the previous mode on destruction. Does nothing when
+// `enable` is false or the target has no such mode.
+class DenormalScope {
+public:
+    explicit DenormalScope(bool enable);
+    ~DenormalScope();
+
+    DenormalScope(const DenormalScope&) = delete;
+    DenormalScope& operator=(const DenormalScope&) = delete;
+
+private:
+    uint64_t saved_ = 0;
+    bool active_;
+};
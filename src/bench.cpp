@@ -0,0 +1,328 @@
+#include "bench.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ground_truth.h"
+#include "metrics.h"
+#include "synth.h"
+#include "work_queue.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+extern std::mutex outputMutex;
+
+namespace {
+
+const AnalysisPreset benchPresets[] = {
+    AnalysisPreset::Legacy, AnalysisPreset::Fast, AnalysisPreset::Balanced, AnalysisPreset::Accurate,
+};
+constexpr size_t presetCount = sizeof(benchPresets) / sizeof(benchPresets[0]);
+
+struct PresetStats {
+    size_t files = 0;
+    size_t correct = 0;
+    double absErrorSum = 0.0;
+    double dspSeconds = 0.0;
+    double audioSeconds = 0.0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int runPresetBenchmark(const PresetBenchOptions& options) {
+    std::vector<TruthEntry> truth;
+    if (!loadTruth(options.truthPath, truth)) {
+        std::cerr << "Cannot read ground truth: " << options.truthPath << std::endl;
+        return 2;
+    }
+    if (truth.empty()) {
+        std::cerr << "No ground-truth entries in " << options.truthPath << std::endl;
+        return 2;
+    }
+
+    std::vector<Analyzer> analyzers;
+    for (AnalysisPreset preset : benchPresets) {
+        AnalyzerConfig config = options.base;
+        config.preset = preset;
+        analyzers.emplace_back(config);
+    }
+
+    std::atomic<size_t> nextFile{0};
+    std::atomic<size_t> failures{0};
+    std::vector<std::vector<PresetStats>> workerStats(options.threads, std::vector<PresetStats>(presetCount));
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < options.threads; ++t) {
+        threads.emplace_back([&, t] {
+            AnalyzerState state;
+            for (size_t index; (index = nextFile.fetch_add(1)) < truth.size();) {
+                const TruthEntry& entry = truth[index];
+                AnalysisResult header = analyzers[0].decodeFile(entry.path, state);
+                if (!header.ok) {
+                    failures.fetch_add(1, std::memory_order_relaxed);
+                    std::lock_guard<std::mutex> guard(outputMutex);
+                    std::cerr << "Error processing " << entry.path << ": " << header.error << std::endl;
+                    continue;
+                }
+
+                // Pipelines only read state.samples, so one decode serves all presets.
+                for (size_t p = 0; p < presetCount; ++p) {
+                    AnalysisResult result = header;
+                    auto start = Clock::now();
+                    analyzers[p].analyzeDecoded(state, result);
+                    PresetStats& s = workerStats[t][p];
+                    s.dspSeconds += secondsSince(start);
+                    s.audioSeconds += double(header.frames) / header.sampleRate;
+                    s.files++;
+                    float error = std::abs(result.bpm - entry.bpm);
+                    s.absErrorSum += error;
+                    if (error <= options.tolerance * entry.bpm) s.correct++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<PresetStats> totals(presetCount);
+    for (const auto& stats : workerStats) {
+        for (size_t p = 0; p < presetCount; ++p) {
+            totals[p].files += stats[p].files;
+            totals[p].correct += stats[p].correct;
+            totals[p].absErrorSum += stats[p].absErrorSum;
+            totals[p].dspSeconds += stats[p].dspSeconds;
+            totals[p].audioSeconds += stats[p].audioSeconds;
+        }
+    }
+
+    if (options.json) {
+        std::cout << "{\"files\":" << truth.size() << ",\"failed\":" << failures.load() << ",\"presets\":[";
+        for (size_t p = 0; p < presetCount; ++p) {
+            const PresetStats& s = totals[p];
+            std::cout << (p ? "," : "") << "{\"preset\":\"" << presetName(benchPresets[p]) << "\""
+                      << ",\"accuracy\":" << (s.files ? double(s.correct) / s.files : 0.0)
+                      << ",\"meanAbsError\":" << (s.files ? s.absErrorSum / s.files : 0.0)
+                      << ",\"dspSeconds\":" << s.dspSeconds
+                      << ",\"realtimeFactor\":" << (s.dspSeconds > 0.0 ? s.audioSeconds / s.dspSeconds : 0.0) << "}";
+        }
+        std::cout << "]}" << std::endl;
+    } else {
+        std::cout << "Preset benchmark: " << truth.size() << " files (" << failures.load() << " failed)\n";
+        std::cout << std::setw(10) << "preset" << std::setw(10) << "accuracy" << std::setw(12) << "meanAbsErr"
+                  << std::setw(10) << "dsp s" << std::setw(12) << "x realtime" << "\n";
+        for (size_t p = 0; p < presetCount; ++p) {
+            const PresetStats& s = totals[p];
+            std::cout << std::fixed << std::setprecision(3) << std::setw(10) << presetName(benchPresets[p])
+                      << std::setw(10) << (s.files ? double(s.correct) / s.files : 0.0) << std::setw(12)
+                      << (s.files ? s.absErrorSum / s.files : 0.0) << std::setw(10) << s.dspSeconds
+                      << std::setprecision(0) << std::setw(12)
+                      << (s.dspSeconds > 0.0 ? s.audioSeconds / s.dspSeconds : 0.0) << "\n";
+        }
+        std::cout.flush();
+    }
+
+    return failures.load() == 0 ? 0 : 1;
+}
+
+namespace {
+
+struct ScalingPoint {
+    unsigned threads = 0;
+    double seconds = 0.0;
+    size_t files = 0;
+    size_t failed = 0;
+    double audioSeconds = 0.0;
+    double inputBytes = 0.0;
+    double popWaitSeconds = 0.0;  // summed over workers: time blocked waiting for work
+    double peakResidentBytes = 0.0;  // process high-water mark during this point
+    WorkQueueStats queue;
+};
+
+// Evicts `path` from the page cache so the next read goes to the device.
+// Returns false where that is not possible; the "cold" numbers are then warm.
+bool evictFromPageCache(const std::string& path) {
+#ifdef POSIX_FADV_DONTNEED
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    ::fdatasync(fd);
+    bool ok = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    ::close(fd);
+    return ok;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+void warmPageCache(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char buffer[1 << 16];
+    while (in.read(buffer, sizeof(buffer))) {
+    }
+}
+
+// One scan of `paths` shaped like the CLI batch mode: a producer feeding a
+// bounded WorkQueue and `threads` workers pulling from it.
+ScalingPoint scanCorpus(const Analyzer& analyzer, const std::vector<std::string>& paths, unsigned threads) {
+    ScalingPoint point;
+    point.threads = threads;
+    WorkQueue<std::string> queue(threads * 64);
+    std::vector<ScalingPoint> workerTotals(threads);
+
+    resetPeakResidentBytes();
+    auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            AnalyzerState state;
+            ScalingPoint& totals = workerTotals[t];
+            std::string path;
+            for (;;) {
+                auto waitStart = Clock::now();
+                if (!queue.pop(path)) break;
+                totals.popWaitSeconds += secondsSince(waitStart);
+                AnalysisResult result = analyzer.analyzeFile(path, state);
+                if (!result.ok) {
+                    totals.failed++;
+                    continue;
+                }
+                totals.files++;
+                totals.audioSeconds += double(result.frames) / result.sampleRate;
+                totals.inputBytes += double(result.inputBytes);
+            }
+        });
+    }
+    for (const auto& path : paths) queue.push(path);
+    queue.close();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    point.seconds = secondsSince(start);
+
+    for (const ScalingPoint& totals : workerTotals) {
+        point.files += totals.files;
+        point.failed += totals.failed;
+        point.audioSeconds += totals.audioSeconds;
+        point.inputBytes += totals.inputBytes;
+        point.popWaitSeconds += totals.popWaitSeconds;
+    }
+    point.peakResidentBytes = peakResidentBytes();
+    point.queue = queue.stats();
+    return point;
+}
+
+// Share of worker time spent blocked in pop(): starvation rather than work.
+double idleShare(const ScalingPoint& p) {
+    return p.seconds > 0.0 ? p.popWaitSeconds / (p.seconds * p.threads) : 0.0;
+}
+
+void printScalingTable(const char* scenario, const std::vector<ScalingPoint>& points) {
+    std::cout << scenario << "\n"
+              << std::setw(8) << "threads" << std::setw(10) << "files/s" << std::setw(10) << "MB/s" << std::setw(12)
+              << "x realtime" << std::setw(9) << "speedup" << std::setw(12) << "efficiency" << std::setw(9)
+              << "peak MB" << std::setw(11) << "contended" << std::setw(9) << "idle %" << "\n";
+    for (const ScalingPoint& p : points) {
+        double speedup = points[0].seconds / p.seconds;
+        std::cout << std::fixed << std::setprecision(1) << std::setw(8) << p.threads << std::setw(10)
+                  << p.files / p.seconds << std::setw(10) << p.inputBytes / p.seconds / 1e6 << std::setw(12)
+                  << p.audioSeconds / p.seconds << std::setprecision(2) << std::setw(9) << speedup << std::setw(12)
+                  << speedup / p.threads << std::setprecision(1) << std::setw(9) << p.peakResidentBytes / 1e6
+                  << std::setw(11) << p.queue.contendedLocks << std::setw(9) << 100.0 * idleShare(p) << "\n";
+    }
+}
+
+void printScalingJson(const char* scenario, const std::vector<ScalingPoint>& points) {
+    std::cout << "{\"scenario\":\"" << scenario << "\",\"points\":[";
+    for (size_t i = 0; i < points.size(); ++i) {
+        const ScalingPoint& p = points[i];
+        double speedup = points[0].seconds / p.seconds;
+        std::cout << (i ? "," : "") << "{\"threads\":" << p.threads << ",\"seconds\":" << p.seconds
+                  << ",\"files\":" << p.files << ",\"failed\":" << p.failed
+                  << ",\"filesPerSecond\":" << p.files / p.seconds
+                  << ",\"bytesPerSecond\":" << p.inputBytes / p.seconds
+                  << ",\"realtimeFactor\":" << p.audioSeconds / p.seconds << ",\"speedup\":" << speedup
+                  << ",\"efficiency\":" << speedup / p.threads << ",\"peakResidentBytes\":" << p.peakResidentBytes
+                  << ",\"contendedLocks\":" << p.queue.contendedLocks << ",\"emptyWaits\":" << p.queue.emptyWaits
+                  << ",\"fullWaits\":" << p.queue.fullWaits << ",\"idleShare\":" << idleShare(p) << "}";
+    }
+    std::cout << "]}";
+}
+
+} // namespace
+
+int runScalingBenchmark(const ScalingBenchOptions& options) {
+    fs::path base = options.directory.empty() ? fs::temp_directory_path() : fs::path(options.directory);
+    fs::path corpus = base / ("bpm-scaling-" + std::to_string(::getpid()));
+    std::error_code ec;
+    fs::create_directories(corpus, ec);
+    if (ec) {
+        std::cerr << "Cannot create " << corpus.string() << ": " << ec.message() << std::endl;
+        return 2;
+    }
+
+    std::vector<TruthEntry> entries;
+    std::string error;
+    if (!writeSyntheticCorpus(corpus.string(), options.files, options.seconds, entries, error)) {
+        std::cerr << error << std::endl;
+        fs::remove_all(corpus, ec);
+        return 1;
+    }
+    std::vector<std::string> paths;
+    for (const TruthEntry& entry : entries) paths.push_back(entry.path);
+
+    std::vector<unsigned> threadCounts;
+    for (unsigned t = 1; t < options.maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(std::max(1u, options.maxThreads));
+
+    const Analyzer analyzer(options.config);
+    std::vector<ScalingPoint> cached, cold;
+    bool evicted = true;
+    for (unsigned threads : threadCounts) {
+        for (const auto& path : paths) warmPageCache(path);
+        cached.push_back(scanCorpus(analyzer, paths, threads));
+
+        for (const auto& path : paths) evicted = evictFromPageCache(path) && evicted;
+        cold.push_back(scanCorpus(analyzer, paths, threads));
+    }
+    fs::remove_all(corpus, ec);
+
+    size_t failed = 0;
+    for (const ScalingPoint& p : cached) failed += p.failed;
+    for (const ScalingPoint& p : cold) failed += p.failed;
+
+    if (!evicted) {
+        std::cerr << "Could not evict the corpus from the page cache; cold results are warm" << std::endl;
+    }
+    if (options.json) {
+        std::cout << "{\"files\":" << options.files << ",\"trackSeconds\":" << options.seconds
+                  << ",\"coldEvicted\":" << (evicted ? "true" : "false") << ",\"scenarios\":[";
+        printScalingJson("cached", cached);
+        std::cout << ",";
+        printScalingJson("cold", cold);
+        std::cout << "]}" << std::endl;
+    } else {
+        std::cout << "Thread scaling: " << options.files << " synthetic files of " << options.seconds << " s\n";
+        printScalingTable("Cached (CPU-bound):", cached);
+        printScalingTable("Cold cache (I/O-bound):", cold);
+        std::cout.flush();
+    }
+    return failed == 0 ? 0 : 1;
+}
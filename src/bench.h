@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+
+#include "analyzer.h"
+
+struct PresetBenchOptions {
+    std::string truthPath;       // TSV of "path<TAB>bpm" lines
+    AnalyzerConfig base;         // preset field is overridden per run
+    unsigned threads = 1;
+    float tolerance = 0.04f;     // relative BPM error counted as correct
+    bool json = false;
+};
+
+// Decodes each ground-truth file once and runs every preset over it, reporting
+// accuracy and DSP throughput per preset. Returns a process exit status.
+int runPresetBenchmark(const PresetBenchOptions& options);
+
+struct ScalingBenchOptions {
+    AnalyzerConfig config;
+    unsigned maxThreads = 1;     // measured at 1, 2, 4, ... and maxThreads
+    size_t files = 32;           // synthetic corpus size
+    double seconds = 30.0;       // length of each synthetic track
+    std::string directory;       // where the corpus is written; default: system temp dir
+    bool json = false;
+};
+
+// Writes a synthetic corpus and scans it through the worker pool at each
+// thread count, once with the files in the page cache (CPU-bound) and once
+// after evicting them (I/O-bound), reporting throughput, parallel
+// efficiency, memory and queue contention. Returns a process exit status.
+int runScalingBenchmark(const ScalingBenchOptions& options);
+
+struct GateBenchOptions {
+    AnalyzerConfig config;
+    unsigned threads = 1;
+    int repetitions = 5;
+    std::string truthPath;       // corpus as "path<TAB>bpm" lines; empty: built-in synthetic corpus
+    float tolerance = 0.04f;     // relative BPM error counted as correct
+    float threshold = 0.05f;     // smallest relative change reported as a regression
+    std::string savePath;        // write this run as the new baseline
+    std::string comparePath;     // compare this run against a saved baseline
+    bool json = false;
+};
+
+// Measures throughput, per-file latency percentiles, peak RSS and accuracy
+// over several repetitions. With comparePath, the corpus, analyzer
+// configuration, threads and repetitions come from the baseline, and a
+// metric is a regression only if it is worse by more than `threshold` and
+// Welch's t-test finds the difference significant at 95%. Returns 1 if
+// anything regressed.
+int runRegressionGate(const GateBenchOptions& options);
@@ -0,0 +1,536 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "ground_truth.h"
+#include "synth.h"
+#include "work_queue.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Bump whenever the built-in corpus or a metric's meaning changes, so stale
+// baselines are refused instead of reported as regressions. 2: synthesis
+// precomputes the beat burst and uses xorshift noise. 3: the analyzer
+// configuration is stored and reapplied on compare.
+constexpr int baselineVersion = 3;
+constexpr size_t syntheticFiles = 24;
+constexpr double syntheticSeconds = 20.0;
+
+struct MetricSpec {
+    const char* name;
+    bool higherIsBetter;
+    bool usesThreshold;  // false: any significant worsening is a regression
+};
+
+const MetricSpec metricSpecs[] = {
+    {"throughput_files_per_s", true, true},
+    {"latency_p50_ms", false, true},
+    {"latency_p95_ms", false, true},
+    {"latency_p99_ms", false, true},
+    {"peak_rss_bytes", false, true},
+    {"accuracy", true, false},
+    {"mean_abs_error_bpm", false, true},
+};
+
+using Samples = std::map<std::string, std::vector<double>>;
+
+// What a baseline was measured on; a comparison reruns exactly this.
+struct GateSetup {
+    AnalyzerConfig config;
+    unsigned threads = 1;
+    int repetitions = 5;
+    std::string truthPath;
+    float tolerance = 0.04f;
+};
+
+// --- Minimal JSON reader for the baseline file ------------------------------
+
+struct JsonValue {
+    enum Kind { Null, Bool, Number, String, Array, Object } kind = Null;
+    double number = 0.0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::map<std::string, JsonValue> members;
+
+    const JsonValue* find(const std::string& key) const {
+        auto it = members.find(key);
+        return it == members.end() ? nullptr : &it->second;
+    }
+};
+
+class JsonReader {
+public:
+    explicit JsonReader(const std::string& text) : text_(text) {}
+
+    bool parse(JsonValue& value) {
+        return parseValue(value) && (skipSpace(), position_ == text_.size());
+    }
+
+private:
+    void skipSpace() {
+        while (position_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[position_]))) ++position_;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (position_ < text_.size() && text_[position_] == c) {
+            ++position_;
+            return true;
+        }
+        return false;
+    }
+
+    bool parseString(std::string& out) {
+        if (!consume('"')) return false;
+        while (position_ < text_.size() && text_[position_] != '"') {
+            char c = text_[position_++];
+            if (c == '\\' && position_ < text_.size()) {
+                char escaped = text_[position_++];
+                c = escaped == 'n' ? '\n' : escaped == 't' ? '\t' : escaped;
+            }
+            out += c;
+        }
+        return position_ < text_.size() && text_[position_++] == '"';
+    }
+
+    bool parseValue(JsonValue& value) {
+        skipSpace();
+        if (position_ >= text_.size()) return false;
+        char c = text_[position_];
+        if (c == '{') {
+            ++position_;
+            value.kind = JsonValue::Object;
+            if (consume('}')) return true;
+            do {
+                std::string key;
+                if (!parseString(key) || !consume(':') || !parseValue(value.members[key])) return false;
+            } while (consume(','));
+            return consume('}');
+        }
+        if (c == '[') {
+            ++position_;
+            value.kind = JsonValue::Array;
+            if (consume(']')) return true;
+            do {
+                value.items.emplace_back();
+                if (!parseValue(value.items.back())) return false;
+            } while (consume(','));
+            return consume(']');
+        }
+        if (c == '"') {
+            value.kind = JsonValue::String;
+            return parseString(value.text);
+        }
+        for (const char* literal : {"true", "false", "null"}) {
+            size_t length = std::strlen(literal);
+            if (text_.compare(position_, length, literal) == 0) {
+                position_ += length;
+                value.kind = literal[0] == 'n' ? JsonValue::Null : JsonValue::Bool;
+                value.number = literal[0] == 't' ? 1.0 : 0.0;
+                return true;
+            }
+        }
+        char* end = nullptr;
+        value.kind = JsonValue::Number;
+        value.number = std::strtod(text_.c_str() + position_, &end);
+        if (end == text_.c_str() + position_) return false;
+        position_ = static_cast<size_t>(end - text_.c_str());
+        return true;
+    }
+
+    const std::string& text_;
+    size_t position_ = 0;
+};
+
+// --- Statistics --------------------------------------------------------------
+
+struct Summary {
+    double mean = 0.0;
+    double variance = 0.0;  // sample variance
+    size_t count = 0;
+};
+
+Summary summarize(const std::vector<double>& values) {
+    Summary s;
+    s.count = values.size();
+    if (values.empty()) return s;
+    for (double v : values) s.mean += v;
+    s.mean /= values.size();
+    if (values.size() > 1) {
+        for (double v : values) s.variance += (v - s.mean) * (v - s.mean);
+        s.variance /= values.size() - 1;
+    }
+    return s;
+}
+
+// Two-sided 95% critical value of Student's t distribution.
+double tCritical(double degreesOfFreedom) {
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (degreesOfFreedom < 1.0) return table[0];
+    size_t index = static_cast<size_t>(degreesOfFreedom);
+    return index <= 30 ? table[index - 1] : 1.96;
+}
+
+double confidenceHalfWidth(const Summary& s) {
+    if (s.count < 2) return 0.0;
+    return tCritical(double(s.count - 1)) * std::sqrt(s.variance / s.count);
+}
+
+// Welch's t-test. Metrics with no spread in either run (accuracy on a fixed
+// corpus) are significant whenever the means differ at all.
+bool significantlyDifferent(const Summary& a, const Summary& b) {
+    double va = a.count ? a.variance / a.count : 0.0;
+    double vb = b.count ? b.variance / b.count : 0.0;
+    if (va + vb == 0.0) return std::abs(a.mean - b.mean) > 1e-9 * std::max(std::abs(a.mean), std::abs(b.mean));
+    double t = std::abs(a.mean - b.mean) / std::sqrt(va + vb);
+    double denominator = (a.count > 1 ? va * va / (a.count - 1) : 0.0) + (b.count > 1 ? vb * vb / (b.count - 1) : 0.0);
+    double degreesOfFreedom = denominator > 0.0 ? (va + vb) * (va + vb) / denominator : 1.0;
+    return t > tCritical(degreesOfFreedom);
+}
+
+// --- Measurement -------------------------------------------------------------
+
+using Clock = std::chrono::steady_clock;
+
+double percentile(std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+struct FileOutcome {
+    double seconds = 0.0;
+    float bpm = 0.0f;
+    bool ok = false;
+};
+
+// One pass over the corpus through a WorkQueue-fed pool, as in batch mode.
+std::vector<FileOutcome> scanOnce(const Analyzer& analyzer, const std::vector<TruthEntry>& corpus,
+                                  unsigned threads, double& wallSeconds) {
+    std::vector<FileOutcome> outcomes(corpus.size());
+    WorkQueue<size_t> queue(threads * 64);
+    auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            AnalyzerState state;
+            size_t index;
+            while (queue.pop(index)) {
+                auto fileStart = Clock::now();
+                AnalysisResult result = analyzer.analyzeFile(corpus[index].path, state);
+                outcomes[index].seconds = std::chrono::duration<double>(Clock::now() - fileStart).count();
+                outcomes[index].ok = result.ok;
+                outcomes[index].bpm = result.bpm;
+            }
+        });
+    }
+    for (size_t i = 0; i < corpus.size(); ++i) queue.push(i);
+    queue.close();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return outcomes;
+}
+
+Samples measure(const GateSetup& setup, const std::vector<TruthEntry>& corpus, size_t& failures) {
+    const Analyzer analyzer(setup.config);
+    double wallSeconds = 0.0;
+    scanOnce(analyzer, corpus, setup.threads, wallSeconds);  // warm-up: page cache, allocator, CPU clocks
+
+    Samples samples;
+    failures = 0;
+    for (int r = 0; r < setup.repetitions; ++r) {
+        // Each repetition gets its own high-water mark.
+        resetPeakResidentBytes();
+        std::vector<FileOutcome> outcomes = scanOnce(analyzer, corpus, setup.threads, wallSeconds);
+
+        std::vector<double> latencies;
+        size_t correct = 0;
+        double absError = 0.0;
+        for (size_t i = 0; i < outcomes.size(); ++i) {
+            if (!outcomes[i].ok) {
+                ++failures;
+                continue;
+            }
+            latencies.push_back(outcomes[i].seconds * 1e3);
+            float error = std::abs(outcomes[i].bpm - corpus[i].bpm);
+            absError += error;
+            if (error <= setup.tolerance * corpus[i].bpm) ++correct;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        samples["throughput_files_per_s"].push_back(corpus.size() / wallSeconds);
+        samples["latency_p50_ms"].push_back(percentile(latencies, 0.50));
+        samples["latency_p95_ms"].push_back(percentile(latencies, 0.95));
+        samples["latency_p99_ms"].push_back(percentile(latencies, 0.99));
+        samples["peak_rss_bytes"].push_back(peakResidentBytes());
+        samples["accuracy"].push_back(double(correct) / corpus.size());
+        samples["mean_abs_error_bpm"].push_back(latencies.empty() ? 0.0 : absError / latencies.size());
+    }
+    return samples;
+}
+
+// --- Baseline file -----------------------------------------------------------
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Every AnalyzerConfig field that changes what a scan computes. Floats are
+// written with 17 digits, so they read back exactly.
+void writeConfig(std::ostream& out, const AnalyzerConfig& config) {
+    out << "{\"threshold\":" << config.threshold << ",\"minGap\":" << config.minGap
+        << ",\"smoothing\":" << config.smoothingFactor << ",\"bpmDivisor\":" << config.bpmDivisor
+        << ",\"hopSize\":" << config.hopSize << ",\"minBpm\":" << config.minBpm << ",\"maxBpm\":" << config.maxBpm
+        << ",\"tempoPriorMin\":" << config.tempoPrior.minBpm << ",\"tempoPriorMax\":" << config.tempoPrior.maxBpm
+        << ",\"blockFrames\":" << config.blockFrames << ",\"tileFrames\":" << config.tileFrames
+        << ",\"computeOverview\":" << (config.computeOverview ? "true" : "false")
+        << ",\"flushDenormals\":" << (config.flushDenormals ? "true" : "false") << "}";
+}
+
+// Reads writeConfig() output back into `config`. Returns false if a field is
+// missing, so a baseline never silently falls back to the current options.
+bool readConfig(const JsonValue& value, AnalyzerConfig& config) {
+    auto number = [&](const char* key, double& out) {
+        const JsonValue* v = value.find(key);
+        if (!v || (v->kind != JsonValue::Number && v->kind != JsonValue::Bool)) return false;
+        out = v->number;
+        return true;
+    };
+    double threshold, minGap, smoothing, divisor, hop, minBpm, maxBpm, priorMin, priorMax, block, tile, overview,
+        flush;
+    if (!number("threshold", threshold) || !number("minGap", minGap) || !number("smoothing", smoothing) ||
+        !number("bpmDivisor", divisor) || !number("hopSize", hop) || !number("minBpm", minBpm) ||
+        !number("maxBpm", maxBpm) || !number("tempoPriorMin", priorMin) || !number("tempoPriorMax", priorMax) ||
+        !number("blockFrames", block) || !number("tileFrames", tile) || !number("computeOverview", overview) ||
+        !number("flushDenormals", flush)) {
+        return false;
+    }
+    config.threshold = static_cast<float>(threshold);
+    config.minGap = static_cast<int>(minGap);
+    config.smoothingFactor = static_cast<float>(smoothing);
+    config.bpmDivisor = static_cast<float>(divisor);
+    config.hopSize = static_cast<int>(hop);
+    config.minBpm = static_cast<float>(minBpm);
+    config.maxBpm = static_cast<float>(maxBpm);
+    config.tempoPrior = {static_cast<float>(priorMin), static_cast<float>(priorMax)};
+    config.blockFrames = static_cast<sf_count_t>(block);
+    config.tileFrames = static_cast<size_t>(tile);
+    config.computeOverview = overview != 0.0;
+    config.flushDenormals = flush != 0.0;
+    return true;
+}
+
+bool saveBaseline(const std::string& path, const GateSetup& setup, const Samples& samples) {
+    std::ofstream out(path, std::ios::trunc);
+    out << std::setprecision(17) << "{\"version\":" << baselineVersion
+        << ",\"preset\":" << jsonString(presetName(setup.config.preset)) << ",\"config\":";
+    writeConfig(out, setup.config);
+    out << ",\"threads\":" << setup.threads << ",\"repetitions\":" << setup.repetitions
+        << ",\"truth\":" << jsonString(setup.truthPath) << ",\"tolerance\":" << setup.tolerance << ",\"metrics\":{";
+    bool first = true;
+    for (const auto& [name, values] : samples) {
+        out << (first ? "" : ",") << "\n  " << jsonString(name) << ":[";
+        for (size_t i = 0; i < values.size(); ++i) out << (i ? "," : "") << values[i];
+        out << "]";
+        first = false;
+    }
+    out << "\n}}\n";
+    return bool(out);
+}
+
+bool loadBaseline(const std::string& path, GateSetup& setup, Samples& samples, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "Cannot read baseline " + path;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+    JsonValue root;
+    if (!JsonReader(text).parse(root) || root.kind != JsonValue::Object) {
+        error = "Malformed baseline " + path;
+        return false;
+    }
+    const JsonValue* version = root.find("version");
+    if (!version || version->number != baselineVersion) {
+        error = "Unsupported baseline version in " + path + "; re-record it with --bench-save";
+        return false;
+    }
+    const JsonValue* preset = root.find("preset");
+    if (!preset || !parsePreset(preset->text, setup.config.preset)) {
+        error = "Unknown preset in baseline " + path;
+        return false;
+    }
+    const JsonValue* config = root.find("config");
+    if (!config || config->kind != JsonValue::Object || !readConfig(*config, setup.config)) {
+        error = "Incomplete analyzer configuration in baseline " + path;
+        return false;
+    }
+    if (const JsonValue* v = root.find("threads")) setup.threads = std::max(1u, static_cast<unsigned>(v->number));
+    if (const JsonValue* v = root.find("repetitions")) setup.repetitions = std::max(1, static_cast<int>(v->number));
+    if (const JsonValue* v = root.find("truth")) setup.truthPath = v->text;
+    if (const JsonValue* v = root.find("tolerance")) setup.tolerance = static_cast<float>(v->number);
+    if (const JsonValue* metrics = root.find("metrics")) {
+        for (const auto& [name, values] : metrics->members) {
+            for (const JsonValue& value : values.items) samples[name].push_back(value.number);
+        }
+    }
+    return true;
+}
+
+// --- Report ------------------------------------------------------------------
+
+enum class Verdict { Unchanged, Improved, Regressed, Missing };
+
+const char* verdictName(Verdict verdict) {
+    switch (verdict) {
+    case Verdict::Unchanged: return "ok";
+    case Verdict::Improved: return "improved";
+    case Verdict::Regressed: return "REGRESSED";
+    case Verdict::Missing: return "no baseline";
+    }
+    return "";
+}
+
+Verdict judge(const MetricSpec& spec, const Summary& baseline, const Summary& current, float threshold) {
+    if (baseline.count == 0) return Verdict::Missing;
+    if (!significantlyDifferent(baseline, current)) return Verdict::Unchanged;
+    double change = baseline.mean != 0.0 ? (current.mean - baseline.mean) / std::abs(baseline.mean)
+                                         : (current.mean > 0.0 ? 1.0 : -1.0);
+    if (spec.usesThreshold && std::abs(change) <= threshold) return Verdict::Unchanged;
+    bool better = spec.higherIsBetter ? change > 0.0 : change < 0.0;
+    return better ? Verdict::Improved : Verdict::Regressed;
+}
+
+} // namespace
+
+int runRegressionGate(const GateBenchOptions& options) {
+    GateSetup setup;
+    setup.config = options.config;
+    setup.threads = options.threads;
+    setup.repetitions = options.repetitions;
+    setup.truthPath = options.truthPath;
+    setup.tolerance = options.tolerance;
+
+    Samples baseline;
+    if (!options.comparePath.empty()) {
+        std::string error;
+        if (!loadBaseline(options.comparePath, setup, baseline, error)) {
+            std::cerr << error << std::endl;
+            return 2;
+        }
+    }
+    std::vector<TruthEntry> corpus;
+    fs::path syntheticDirectory;
+    std::error_code ec;
+    if (!setup.truthPath.empty()) {
+        if (!loadTruth(setup.truthPath, corpus) || corpus.empty()) {
+            std::cerr << "Cannot read ground truth: " << setup.truthPath << std::endl;
+            return 2;
+        }
+    } else {
+        syntheticDirectory = fs::temp_directory_path() / ("bpm-gate-" + std::to_string(::getpid()));
+        fs::create_directories(syntheticDirectory, ec);
+        std::string error;
+        if (ec || !writeSyntheticCorpus(syntheticDirectory.string(), syntheticFiles, syntheticSeconds, corpus, error)) {
+            std::cerr << (ec ? "Cannot create " + syntheticDirectory.string() : error) << std::endl;
+            fs::remove_all(syntheticDirectory, ec);
+            return 2;
+        }
+    }
+
+    size_t failures = 0;
+    Samples current = measure(setup, corpus, failures);
+    if (!syntheticDirectory.empty()) fs::remove_all(syntheticDirectory, ec);
+
+    bool compare = !options.comparePath.empty();
+    bool regressed = false;
+    if (options.json) std::cout << "{\"failures\":" << failures << ",\"metrics\":[";
+    else {
+        std::cout << "Regression gate: preset " << presetName(setup.config.preset) << ", " << setup.threads << " threads, "
+                  << setup.repetitions << " repetitions over " << corpus.size() << " files (mean +/- 95% CI)\n"
+                  << std::left << std::setw(24) << "metric" << std::right;
+        if (compare) std::cout << std::setw(26) << "baseline";
+        std::cout << std::setw(26) << "current";
+        if (compare) std::cout << std::setw(10) << "change" << std::setw(13) << "verdict";
+        std::cout << "\n";
+    }
+
+    bool first = true;
+    for (const MetricSpec& spec : metricSpecs) {
+        Summary now = summarize(current[spec.name]);
+        Summary before = summarize(baseline[spec.name]);
+        Verdict verdict = compare ? judge(spec, before, now, options.threshold) : Verdict::Unchanged;
+        regressed |= verdict == Verdict::Regressed;
+        double change = before.mean != 0.0 ? 100.0 * (now.mean - before.mean) / std::abs(before.mean) : 0.0;
+
+        if (options.json) {
+            std::cout << (first ? "" : ",") << "{\"name\":\"" << spec.name << "\",\"mean\":" << now.mean
+                      << ",\"ci95\":" << confidenceHalfWidth(now);
+            if (compare) {
+                std::cout << ",\"baselineMean\":" << before.mean << ",\"baselineCi95\":" << confidenceHalfWidth(before)
+                          << ",\"changePercent\":" << change << ",\"verdict\":\"" << verdictName(verdict) << "\"";
+            }
+            std::cout << "}";
+            first = false;
+            continue;
+        }
+
+        auto cell = [](const Summary& s) {
+            std::ostringstream text;
+            text << std::setprecision(4) << s.mean << " +/- " << std::setprecision(2) << confidenceHalfWidth(s);
+            return text.str();
+        };
+        std::cout << std::left << std::setw(24) << spec.name << std::right;
+        if (compare) std::cout << std::setw(26) << cell(before);
+        std::cout << std::setw(26) << cell(now);
+        if (compare) {
+            std::cout << std::fixed << std::setprecision(1) << std::setw(9) << change << "%" << std::setw(13)
+                      << verdictName(verdict) << std::defaultfloat;
+        }
+        std::cout << "\n";
+    }
+    if (options.json) {
+        std::cout << "],\"regressed\":" << (regressed ? "true" : "false") << "}" << std::endl;
+    } else {
+        if (failures) std::cout << failures << " file analyses failed\n";
+        if (compare) std::cout << (regressed ? "Regression detected" : "No significant regressions") << "\n";
+        std::cout.flush();
+    }
+
+    if (!options.savePath.empty()) {
+        if (!saveBaseline(options.savePath, setup, current)) {
+            std::cerr << "Cannot write baseline " << options.savePath << std::endl;
+            return 2;
+        }
+        std::cerr << "Baseline saved to " << options.savePath << std::endl;
+    }
+    return regressed || failures ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+// Feeds malformed in-memory WAV files through Analyzer::analyzeMemory() and
+// checks that each one is rejected with an error instead of being decoded.
+// Exits non-zero if any case is accepted; run with `make test`.
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "analyzer.h"
+
+namespace {
+
+void putU16(std::vector<unsigned char>& out, uint16_t value) {
+    out.push_back(value & 0xff);
+    out.push_back(value >> 8);
+}
+
+void putU32(std::vector<unsigned char>& out, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        out.push_back((value >> shift) & 0xff);
+    }
+}
+
+void putTag(std::vector<unsigned char>& out, const char* tag) {
+    out.insert(out.end(), tag, tag + 4);
+}
+
+// A 16-bit PCM WAV whose header claims `channels` channels, followed by
+// `dataBytes` bytes of silence.
+std::vector<unsigned char> makeWav(uint16_t channels, uint32_t dataBytes) {
+    const uint32_t sampleRate = 44100;
+    const uint16_t blockAlign = channels * 2;
+    std::vector<unsigned char> wav;
+    putTag(wav, "RIFF");
+    putU32(wav, 36 + dataBytes);
+    putTag(wav, "WAVE");
+    putTag(wav, "fmt ");
+    putU32(wav, 16);
+    putU16(wav, 1);
+    putU16(wav, channels);
+    putU32(wav, sampleRate);
+    putU32(wav, sampleRate * blockAlign);
+    putU16(wav, blockAlign);
+    putU16(wav, 16);
+    putTag(wav, "data");
+    putU32(wav, dataBytes);
+    wav.insert(wav.end(), dataBytes, 0);
+    return wav;
+}
+
+bool expectRejected(const std::string& label, const std::vector<unsigned char>& wav) {
+    Analyzer analyzer;
+    AnalyzerState state;
+    AnalysisResult result = analyzer.analyzeMemory(wav.data(), wav.size(), label, state);
+    if (result.ok || result.error.empty()) {
+        std::cerr << "FAIL " << label << ": expected an error, got "
+                  << (result.ok ? "a result" : "no message") << std::endl;
+        return false;
+    }
+    std::cout << "ok   " << label << ": " << result.error << std::endl;
+    return true;
+}
+
+} // namespace
+
+int main() {
+    bool passed = true;
+    passed &= expectRejected("zero frames", makeWav(2, 0));
+    passed &= expectRejected("zero channels", makeWav(0, 4096));
+    passed &= expectRejected("zero frames and channels", makeWav(0, 0));
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,278 @@
+// Writes a synthetic music library for load tests: artist/album/track
+// directories of generated audio plus manifest.tsv, a ground-truth file in
+// the "path<TAB>bpm" format read by --sweep, --bench-presets and
+// --bench-truth. The layout and every track parameter derive from --seed, so
+// the same options always produce the same library.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "synth.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Range {
+    double low;
+    double high;
+};
+
+struct Options {
+    std::string directory;
+    size_t files = 1000;
+    std::vector<SynthFormat> formats = {SynthFormat::Wav};
+    std::vector<int> sampleRates = {44100};
+    std::vector<int> channelCounts = {2};
+    Range seconds = {20.0, 60.0};
+    Range tempo = {70.0, 180.0};
+    Range noise = {0.005, 0.05};
+    double rampShare = 0.1;     // tracks whose tempo drifts by up to +/-8%
+    double silenceShare = 0.1;  // tracks with leading and trailing silence
+    uint32_t seed = 1;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+struct PlannedTrack {
+    std::string path;
+    SynthTrack track;
+};
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " DIR [options]\n"
+              << "  --files N            number of tracks (default: 1000)\n"
+              << "  --formats LIST       wav,aiff,flac (default: wav); chosen per album\n"
+              << "  --rates LIST         sample rates (default: 44100); chosen per album\n"
+              << "  --channels LIST      channel counts (default: 2)\n"
+              << "  --seconds MIN:MAX    track length (default: 20:60)\n"
+              << "  --tempo MIN:MAX      BPM (default: 70:180)\n"
+              << "  --noise MIN:MAX      noise amplitude (default: 0.005:0.05)\n"
+              << "  --ramp-share X       share of tracks with a tempo ramp (default: 0.1)\n"
+              << "  --silence-share X    share of tracks with leading/trailing silence (default: 0.1)\n"
+              << "  --seed N             layout and audio seed (default: 1)\n"
+              << "  -j, --threads N      writer threads (default: hardware concurrency)\n";
+}
+
+bool parseRange(const char* text, Range& range) {
+    char* end = nullptr;
+    range.low = std::strtod(text, &end);
+    if (end == text || *end != ':') return false;
+    const char* high = end + 1;
+    range.high = std::strtod(high, &end);
+    return end != high && *end == '\0' && range.low <= range.high;
+}
+
+bool parseShare(const char* text, double& share) {
+    char* end = nullptr;
+    share = std::strtod(text, &end);
+    return end != text && *end == '\0' && share >= 0.0 && share <= 1.0;
+}
+
+bool parseSeed(const char* text, uint32_t& seed) {
+    char* end = nullptr;
+    unsigned long parsed = std::strtoul(text, &end, 10);
+    seed = static_cast<uint32_t>(parsed);
+    return end != text && *end == '\0' && text[0] != '-' && parsed <= std::numeric_limits<uint32_t>::max();
+}
+
+template <typename T, typename Parse>
+bool parseList(const char* text, std::vector<T>& values, Parse parse) {
+    values.clear();
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        T value;
+        if (!parse(item, value)) return false;
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+bool parsePositive(const std::string& text, int& value) {
+    char* end = nullptr;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (end == text.c_str() || *end != '\0' || parsed < 1 || parsed > std::numeric_limits<int>::max()) return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (arg == "--files") {
+            if (!(v = value()) || std::atol(v) < 1) return false;
+            options.files = static_cast<size_t>(std::atol(v));
+        } else if (arg == "--formats") {
+            if (!(v = value()) || !parseList(v, options.formats, parseSynthFormat)) return false;
+        } else if (arg == "--rates") {
+            if (!(v = value()) || !parseList(v, options.sampleRates, parsePositive)) return false;
+        } else if (arg == "--channels") {
+            if (!(v = value()) || !parseList(v, options.channelCounts, parsePositive)) return false;
+        } else if (arg == "--seconds") {
+            if (!(v = value()) || !parseRange(v, options.seconds) || options.seconds.low <= 0.0) return false;
+        } else if (arg == "--tempo") {
+            if (!(v = value()) || !parseRange(v, options.tempo) || options.tempo.low <= 0.0) return false;
+        } else if (arg == "--noise") {
+            if (!(v = value()) || !parseRange(v, options.noise) || options.noise.low < 0.0) return false;
+        } else if (arg == "--ramp-share") {
+            if (!(v = value()) || !parseShare(v, options.rampShare)) return false;
+        } else if (arg == "--silence-share") {
+            if (!(v = value()) || !parseShare(v, options.silenceShare)) return false;
+        } else if (arg == "--seed") {
+            if (!(v = value()) || !parseSeed(v, options.seed)) return false;
+        } else if (arg == "-j" || arg == "--threads") {
+            if (!(v = value()) || std::atoi(v) < 1) return false;
+            options.threads = static_cast<unsigned>(std::atoi(v));
+        } else if (!arg.empty() && arg[0] != '-' && options.directory.empty()) {
+            options.directory = arg;
+        } else {
+            return false;
+        }
+    }
+    return !options.directory.empty();
+}
+
+std::string numbered(const char* prefix, size_t number, int width) {
+    char text[64];
+    std::snprintf(text, sizeof(text), "%s %0*zu", prefix, width, number);
+    return text;
+}
+
+// Lays out artists with 1-5 albums of 6-14 tracks, like a real collection,
+// and draws every track's parameters. Format and sample rate are per album.
+std::vector<PlannedTrack> planLibrary(const Options& options, const fs::path& root) {
+    std::mt19937 random(options.seed);
+    auto uniform = [&](Range range) { return std::uniform_real_distribution<double>(range.low, range.high)(random); };
+    auto chance = [&](double share) { return std::uniform_real_distribution<double>(0.0, 1.0)(random) < share; };
+    auto pick = [&](const auto& values) { return values[random() % values.size()]; };
+
+    std::vector<PlannedTrack> plan;
+    plan.reserve(options.files);
+    for (size_t artist = 1; plan.size() < options.files; ++artist) {
+        size_t albums = 1 + random() % 5;
+        for (size_t album = 1; album <= albums && plan.size() < options.files; ++album) {
+            fs::path albumDirectory = root / numbered("Artist", artist, 5) / numbered("Album", album, 2);
+            SynthFormat format = pick(options.formats);
+            int sampleRate = pick(options.sampleRates);
+            size_t tracks = 6 + random() % 9;
+            for (size_t number = 1; number <= tracks && plan.size() < options.files; ++number) {
+                PlannedTrack planned;
+                SynthTrack& track = planned.track;
+                track.format = format;
+                track.sampleRate = sampleRate;
+                track.channels = pick(options.channelCounts);
+                track.seconds = uniform(options.seconds);
+                track.bpm = static_cast<float>(uniform(options.tempo));
+                if (chance(options.rampShare)) track.endBpm = track.bpm * static_cast<float>(uniform({0.92, 1.08}));
+                if (chance(options.silenceShare)) {
+                    track.leadingSilence = std::min(uniform({0.5, 4.0}), track.seconds / 4.0);
+                    track.trailingSilence = std::min(uniform({0.5, 6.0}), track.seconds / 4.0);
+                }
+                track.noiseLevel = static_cast<float>(uniform(options.noise));
+                track.seed = static_cast<uint32_t>(random());
+                planned.path = (albumDirectory / (numbered("Track", number, 2) + "." +
+                                                  synthFormatExtension(format))).string();
+                plan.push_back(std::move(planned));
+            }
+        }
+    }
+    return plan;
+}
+
+bool writeManifest(const fs::path& path, const std::vector<PlannedTrack>& plan) {
+    std::ofstream out(path, std::ios::trunc);
+    out << "# path\tbpm\tformat\tsample_rate\tchannels\tseconds\tstart_bpm\tend_bpm\tleading_silence\t"
+           "trailing_silence\tnoise\n";
+    for (const PlannedTrack& planned : plan) {
+        const SynthTrack& t = planned.track;
+        out << planned.path << '\t' << synthMeanBpm(t) << '\t' << synthFormatExtension(t.format) << '\t'
+            << t.sampleRate << '\t' << t.channels << '\t' << t.seconds << '\t' << t.bpm << '\t'
+            << (t.endBpm > 0.0f ? t.endBpm : t.bpm) << '\t' << t.leadingSilence << '\t' << t.trailingSilence << '\t'
+            << t.noiseLevel << '\n';
+    }
+    return bool(out);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    std::error_code ec;
+    fs::path root = fs::absolute(options.directory, ec);
+    std::vector<PlannedTrack> plan = planLibrary(options, root);
+    for (const PlannedTrack& planned : plan) {
+        fs::create_directories(fs::path(planned.path).parent_path(), ec);
+        if (ec) {
+            std::cerr << "Cannot create " << fs::path(planned.path).parent_path().string() << ": " << ec.message()
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> written{0};
+    std::atomic<bool> failed{false};
+    std::mutex errorMutex;
+    std::string firstError;
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < options.threads; ++t) {
+        workers.emplace_back([&] {
+            std::vector<float> audio;
+            for (size_t index; !failed.load(std::memory_order_relaxed) && (index = next.fetch_add(1)) < plan.size();) {
+                const PlannedTrack& planned = plan[index];
+                synthesizeTrack(planned.track, audio);
+                std::string error;
+                if (!writeAudioFile(planned.path, audio, planned.track.sampleRate, planned.track.channels,
+                                    planned.track.format, error)) {
+                    std::lock_guard<std::mutex> guard(errorMutex);
+                    if (!failed.exchange(true)) firstError = error;
+                    return;
+                }
+                size_t done = written.fetch_add(1) + 1;
+                if (done % 1000 == 0) {
+                    std::lock_guard<std::mutex> guard(errorMutex);
+                    std::cerr << "\r" << done << " / " << plan.size() << " files" << std::flush;
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (failed) {
+        std::cerr << "\n" << firstError << std::endl;
+        return 1;
+    }
+
+    fs::path manifest = root / "manifest.tsv";
+    if (!writeManifest(manifest, plan)) {
+        std::cerr << "Cannot write " << manifest.string() << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "\rWrote " << plan.size() << " files in " << seconds << " s (" << plan.size() / seconds
+              << " files/s); manifest: " << manifest.string() << std::endl;
+    return 0;
+}
@@ -0,0 +1,20 @@
+#include "ground_truth.h"
+
+#include <cstdlib>
+#include <fstream>
+
+bool loadTruth(const std::string& path, std::vector<TruthEntry>& entries) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos) continue;
+        char* end = nullptr;
+        float bpm = std::strtof(line.c_str() + tab + 1, &end);
+        if (end == line.c_str() + tab + 1 || bpm <= 0.0f) continue;
+        entries.push_back({line.substr(0, tab), bpm});
+    }
+    return true;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct TruthEntry {
+    std::string path;
+    float bpm;
+};
+
+// Reads "path<TAB>bpm" lines; blank lines and lines starting with '#' are
+// skipped, as are any columns after the BPM. Returns false if the file
+// cannot be opened.
+bool loadTruth(const std::string& path, std::vector<TruthEntry>& entries);
@@ -1,152 +1,737 @@
 #include <iostream>
 #include <filesystem>
-#include <sndfile.h>
 #include <vector>
-#include <cmath>
-#include <algorithm>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <limits>
+
+#include "analyzer.h"
+#include "bench.h"
+#include "metrics.h"
+#include "server.h"
+#include "sweep.h"
+#include "trace.h"
+#include "work_queue.h"
 
 namespace fs = std::filesystem;
 
 std::mutex outputMutex;
 
-std::vector<int> detectPeaks(const std::vector<float>& signal, float threshold, int minGap) {
-    std::vector<int> peaks;
-    for (size_t i = 1; i < signal.size() - 1; ++i) {
-        // Check if this point is a local maximum and exceeds the threshold
-        if (signal[i] > signal[i - 1] && signal[i] > signal[i + 1] && signal[i] > threshold) {
-            if (peaks.empty() || (i - peaks.back()) > minGap) {
-                peaks.push_back(i);
-            }
-        }
-    }
-    return peaks;
-}
+enum class OutputFormat { Text, Tsv, Json };
 
-float calculateBpm(const std::vector<int>& peaks, int sampleRate) {
-    if (peaks.size() < 2) return 0.0f;
+struct CliOptions {
+    std::vector<std::string> paths;
+    bool recursive = false;
+    bool readStdin = false;
+    char stdinDelimiter = '\n';
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    OutputFormat format = OutputFormat::Text;
+    AnalyzerConfig config;
+    std::string sweepTruthPath;
+    SweepGrid sweepGrid;
+    float sweepTolerance = 0.04f;
+    std::string presetBenchTruthPath;
+    bool scalingBench = false;
+    long scalingFiles = 32;
+    float scalingSeconds = 30.0f;
+    std::string scalingDirectory;
+    std::string gateSavePath;
+    std::string gateComparePath;
+    std::string gateTruthPath;
+    long gateRepetitions = 5;
+    float gateThreshold = 0.05f;
+    std::string serveSocketPath;
+    float backgroundShare = 0.5f;
+    std::string resultRing;
+    long maxBufferMiB = 256;
+    int metricsPort = 0;
+    std::string metricsFile;
+    float metricsInterval = 10.0f;
+    std::string tracePath;
+    bool perfCounters = false;
+    bool memoryStats = false;
+    size_t batchFiles = 1;
+};
 
-    float totalTimeBetweenPeaks = 0.0f;
-    for (size_t i = 1; i < peaks.size(); ++i) {
-        float timeBetweenPeaks = static_cast<float>(peaks[i] - peaks[i - 1]) / sampleRate;
-        totalTimeBetweenPeaks += timeBetweenPeaks;
-    }
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] [path...]\n"
+              << "\n"
+              << "Paths may be audio files or directories. With no paths and no --stdin,\n"
+              << "the ./test directory is scanned.\n"
+              << "\n"
+              << "Options:\n"
+              << "  -r, --recursive        descend into subdirectories\n"
+              << "      --stdin            read file paths from stdin, one per line\n"
+              << "  -0, --null             stdin paths are NUL-separated (implies --stdin)\n"
+              << "  -j, --threads N        worker threads (default: hardware concurrency)\n"
+              << "  -f, --format FMT       output format: text, tsv, json (default: text)\n"
+              << "  -p, --preset NAME      legacy, fast, balanced or accurate (default: legacy)\n"
+              << "      --threshold X      peak threshold (default: 0.05)\n"
+              << "      --min-gap N        minimum samples between peaks (default: 500)\n"
+              << "      --smoothing X      envelope smoothing factor (default: 0.1)\n"
+              << "      --bpm-divisor X    scale applied to the raw BPM (default: 35)\n"
+              << "      --hop-size N       onset presets: samples per onset frame (default: 512)\n"
+              << "      --min-bpm X, --max-bpm X\n"
+              << "                         onset presets: tempo search range (default: 60 to 200)\n"
+              << "      --tempo-prior P    genre range the onset presets favour when resolving half/double\n"
+              << "                         tempo: house, techno, trance, dnb, hiphop, dubstep or MIN:MAX\n"
+              << "      --batch-files N    analyze up to N files per task; legacy decodes them into one\n"
+              << "                         buffer and computes envelopes across files (short clips; try 32)\n"
+              << "                         (--perf-counters then lists a file's decode and stages apart)\n"
+              << "      --tile-frames N    legacy: run the stages per cache-sized tile of N frames while\n"
+              << "                         decoding (0 = whole-file passes, the default; try 32768)\n"
+              << "      --keep-denormals   run the DSP without flush-to-zero/denormals-are-zero (slow on\n"
+              << "                         x86 over silence; for comparison)\n"
+              << "      --metrics-port N   serve Prometheus metrics on 127.0.0.1:N\n"
+              << "      --metrics-file PATH\n"
+              << "                         rewrite Prometheus metrics to PATH periodically and at exit\n"
+              << "      --metrics-interval S\n"
+              << "                         seconds between metrics file writes (default: 10)\n"
+              << "      --trace PATH       write a Chrome trace (Perfetto) of worker activity to PATH at exit\n"
+              << "                         (recording stops after about 128 MiB of events)\n"
+              << "      --perf-counters    summarize hardware counters per stage, thread and file at exit\n"
+              << "      --memory-stats     summarize heap use per worker and file, and peak RSS, at exit\n"
+              << "\n"
+              << "Daemon mode:\n"
+              << "      --serve SOCKET     serve analysis requests on a Unix domain socket\n"
+              << "      --background-share X\n"
+              << "                         share of workers background jobs may use during playback (default: 0.5)\n"
+              << "      --result-ring NAME publish results to shared-memory ring NAME (e.g. /bpm-results)\n"
+              << "      --max-buffer MB    largest buffer request accepted; larger ones close the connection\n"
+              << "                         (default: 256)\n"
+              << "\n"
+              << "Parameter sweep:\n"
+              << "      --sweep TRUTH      evaluate a parameter grid against TRUTH (path<TAB>bpm lines)\n"
+              << "      --sweep-thresholds LIST, --sweep-min-gaps LIST, --sweep-smoothing LIST\n"
+              << "                         legacy preset; values as a,b,c or start:stop:step\n"
+              << "      --sweep-hop-sizes LIST, --sweep-min-bpm LIST, --sweep-max-bpm LIST\n"
+              << "                         fast, balanced and accurate presets; values as above\n"
+              << "      --sweep-tempo-priors LIST\n"
+              << "                         comma-separated --tempo-prior values to sweep\n"
+              << "      --tolerance X      relative BPM error counted as correct (default: 0.04)\n"
+              << "      --bench-presets TRUTH\n"
+              << "                         report accuracy and throughput of every preset on TRUTH\n"
+              << "      --bench-scaling    scan a synthetic corpus at 1, 2, 4, ... -j threads, cached and cold\n"
+              << "      --scaling-files N  synthetic files for --bench-scaling (default: 32)\n"
+              << "      --scaling-seconds S\n"
+              << "                         length of each synthetic file (default: 30)\n"
+              << "      --scaling-dir DIR  where to write the corpus (default: system temp dir)\n"
+              << "      --bench-save FILE  measure throughput, latency, memory and accuracy; save as baseline\n"
+              << "      --bench-compare FILE\n"
+              << "                         rerun FILE's benchmark and exit 1 on significant regressions\n"
+              << "      --bench-truth TRUTH\n"
+              << "                         corpus for --bench-save (default: built-in synthetic corpus)\n"
+              << "      --repetitions N    measured repetitions for --bench-save (default: 5)\n"
+              << "      --gate-threshold X smallest relative change counted as a regression (default: 0.05)\n"
+              << "\n"
+              << "  -h, --help             show this help\n";
+}
 
-    float avgTimeBetweenPeaks = totalTimeBetweenPeaks / (peaks.size() - 1);
-    float bpm = 60.0f / avgTimeBetweenPeaks;
-    return bpm;
+bool parseFloat(const char* text, float& value) {
+    char* end = nullptr;
+    value = std::strtof(text, &end);
+    return end != text && *end == '\0';
 }
 
-void listWavFiles(const std::string& folderPath) {
-    for (const auto& entry : fs::directory_iterator(folderPath)) {
-        if (entry.path().extension() == ".wav" || entry.path().extension() == ".mp3") {
-            std::lock_guard<std::mutex> guard(outputMutex);
-            std::cout << "Found: " << entry.path().filename() << std::endl;
-        }
+bool parseInt(const char* text, long& value) {
+    char* end = nullptr;
+    value = std::strtol(text, &end, 10);
+    return end != text && *end == '\0';
+}
+
+// Parses a sweep list whose values must all be whole numbers >= `min`.
+bool parseIntSweepList(const char* text, long min, std::vector<int>& values) {
+    std::vector<float> parsed;
+    if (!parseSweepList(text, parsed)) return false;
+    values.clear();
+    for (float value : parsed) {
+        if (value < min || value != std::floor(value) || value > std::numeric_limits<int>::max()) return false;
+        values.push_back(static_cast<int>(value));
     }
+    return true;
 }
 
-void testFileReading(const std::string& filepath) {
-    SF_INFO sfinfo;
-    SNDFILE* file = sf_open(filepath.c_str(), SFM_READ, &sfinfo);
+// Returns false (after printing a message) if the arguments are invalid.
+bool parseArguments(int argc, char** argv, CliOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto needValue = [&](const char* name) -> const char* {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << name << std::endl;
+                return nullptr;
+            }
+            return argv[++i];
+        };
 
-    if (!file) {
-        std::lock_guard<std::mutex> guard(outputMutex);
-        std::cerr << "Error opening file: " << filepath << std::endl;
-        std::cerr << "Libsndfile error: " << sf_strerror(file) << std::endl;
-        return;
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            std::exit(0);
+        } else if (arg == "-r" || arg == "--recursive") {
+            options.recursive = true;
+        } else if (arg == "--stdin") {
+            options.readStdin = true;
+        } else if (arg == "-0" || arg == "--null") {
+            options.readStdin = true;
+            options.stdinDelimiter = '\0';
+        } else if (arg == "-j" || arg == "--threads") {
+            const char* value = needValue("--threads");
+            long threads = 0;
+            if (!value || !parseInt(value, threads) || threads < 1) {
+                std::cerr << "Invalid thread count" << std::endl;
+                return false;
+            }
+            options.threads = static_cast<unsigned>(threads);
+        } else if (arg == "-f" || arg == "--format") {
+            const char* value = needValue("--format");
+            if (!value) return false;
+            if (std::strcmp(value, "text") == 0) options.format = OutputFormat::Text;
+            else if (std::strcmp(value, "tsv") == 0) options.format = OutputFormat::Tsv;
+            else if (std::strcmp(value, "json") == 0) options.format = OutputFormat::Json;
+            else {
+                std::cerr << "Unknown output format: " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "-p" || arg == "--preset") {
+            const char* value = needValue("--preset");
+            if (!value || !parsePreset(value, options.config.preset)) {
+                std::cerr << "Unknown preset" << std::endl;
+                return false;
+            }
+        } else if (arg == "--threshold") {
+            const char* value = needValue("--threshold");
+            if (!value || !parseFloat(value, options.config.threshold)) {
+                std::cerr << "Invalid threshold" << std::endl;
+                return false;
+            }
+        } else if (arg == "--min-gap") {
+            const char* value = needValue("--min-gap");
+            long minGap = 0;
+            if (!value || !parseInt(value, minGap) || minGap < 0 || minGap > std::numeric_limits<int>::max()) {
+                std::cerr << "Invalid min gap" << std::endl;
+                return false;
+            }
+            options.config.minGap = static_cast<int>(minGap);
+        } else if (arg == "--smoothing") {
+            const char* value = needValue("--smoothing");
+            float smoothing = 0.0f;
+            if (!value || !parseFloat(value, smoothing) || smoothing <= 0.0f || smoothing > 1.0f) {
+                std::cerr << "Invalid smoothing factor (expected 0 < x <= 1)" << std::endl;
+                return false;
+            }
+            options.config.smoothingFactor = smoothing;
+        } else if (arg == "--bpm-divisor") {
+            const char* value = needValue("--bpm-divisor");
+            float divisor = 0.0f;
+            if (!value || !parseFloat(value, divisor) || divisor <= 0.0f) {
+                std::cerr << "Invalid BPM divisor" << std::endl;
+                return false;
+            }
+            options.config.bpmDivisor = divisor;
+        } else if (arg == "--hop-size") {
+            const char* value = needValue("--hop-size");
+            long hopSize = 0;
+            if (!value || !parseInt(value, hopSize) || hopSize < 1 || hopSize > std::numeric_limits<int>::max()) {
+                std::cerr << "Invalid hop size" << std::endl;
+                return false;
+            }
+            options.config.hopSize = static_cast<int>(hopSize);
+        } else if (arg == "--min-bpm" || arg == "--max-bpm") {
+            const char* value = needValue(arg.c_str());
+            float bpm = 0.0f;
+            if (!value || !parseFloat(value, bpm) || !(bpm > 0.0f) || !std::isfinite(bpm)) {
+                std::cerr << "Invalid value for " << arg << std::endl;
+                return false;
+            }
+            (arg == "--min-bpm" ? options.config.minBpm : options.config.maxBpm) = bpm;
+        } else if (arg == "--batch-files") {
+            const char* value = needValue("--batch-files");
+            long batchFiles = 0;
+            if (!value || !parseInt(value, batchFiles) || batchFiles < 1) {
+                std::cerr << "Invalid batch size" << std::endl;
+                return false;
+            }
+            options.batchFiles = static_cast<size_t>(batchFiles);
+        } else if (arg == "--tile-frames") {
+            const char* value = needValue("--tile-frames");
+            long tileFrames = 0;
+            if (!value || !parseInt(value, tileFrames) || tileFrames < 0) {
+                std::cerr << "Invalid tile size" << std::endl;
+                return false;
+            }
+            options.config.tileFrames = static_cast<size_t>(tileFrames);
+        } else if (arg == "--tempo-prior") {
+            const char* value = needValue("--tempo-prior");
+            if (!value || !parseTempoPrior(value, options.config.tempoPrior)) {
+                std::cerr << "Invalid tempo prior" << std::endl;
+                return false;
+            }
+        } else if (arg == "--keep-denormals") {
+            options.config.flushDenormals = false;
+        } else if (arg == "--sweep") {
+            const char* value = needValue("--sweep");
+            if (!value) return false;
+            options.sweepTruthPath = value;
+        } else if (arg == "--sweep-thresholds" || arg == "--sweep-smoothing") {
+            const char* value = needValue(arg.c_str());
+            std::vector<float>& list =
+                arg == "--sweep-thresholds" ? options.sweepGrid.thresholds : options.sweepGrid.smoothingFactors;
+            if (!value || !parseSweepList(value, list)) {
+                std::cerr << "Invalid value list for " << arg << std::endl;
+                return false;
+            }
+        } else if (arg == "--sweep-min-bpm" || arg == "--sweep-max-bpm") {
+            const char* value = needValue(arg.c_str());
+            std::vector<float>& list = arg == "--sweep-min-bpm" ? options.sweepGrid.minBpms : options.sweepGrid.maxBpms;
+            if (!value || !parseSweepList(value, list) || *std::min_element(list.begin(), list.end()) <= 0.0f) {
+                std::cerr << "Invalid value list for " << arg << std::endl;
+                return false;
+            }
+        } else if (arg == "--sweep-hop-sizes") {
+            const char* value = needValue("--sweep-hop-sizes");
+            if (!value || !parseIntSweepList(value, 1, options.sweepGrid.hopSizes)) {
+                std::cerr << "Invalid value list for --sweep-hop-sizes" << std::endl;
+                return false;
+            }
+        } else if (arg == "--sweep-tempo-priors") {
+            const char* value = needValue("--sweep-tempo-priors");
+            if (!value) return false;
+            std::istringstream list(value);
+            std::string item;
+            options.sweepGrid.tempoPriors.clear();
+            while (std::getline(list, item, ',')) {
+                TempoPrior prior;
+                if (!parseTempoPrior(item, prior)) {
+                    std::cerr << "Invalid tempo prior in --sweep-tempo-priors: " << item << std::endl;
+                    return false;
+                }
+                options.sweepGrid.tempoPriors.push_back(prior);
+            }
+            if (options.sweepGrid.tempoPriors.empty()) return false;
+        } else if (arg == "--sweep-min-gaps") {
+            const char* value = needValue("--sweep-min-gaps");
+            if (!value || !parseIntSweepList(value, 0, options.sweepGrid.minGaps)) {
+                std::cerr << "Invalid value list for --sweep-min-gaps" << std::endl;
+                return false;
+            }
+        } else if (arg == "--metrics-port") {
+            const char* value = needValue("--metrics-port");
+            long port = 0;
+            if (!value || !parseInt(value, port) || port < 1 || port > 65535) {
+                std::cerr << "Invalid metrics port" << std::endl;
+                return false;
+            }
+            options.metricsPort = static_cast<int>(port);
+        } else if (arg == "--metrics-file") {
+            const char* value = needValue("--metrics-file");
+            if (!value) return false;
+            options.metricsFile = value;
+        } else if (arg == "--metrics-interval") {
+            const char* value = needValue("--metrics-interval");
+            if (!value || !parseFloat(value, options.metricsInterval) || options.metricsInterval <= 0.0f) {
+                std::cerr << "Invalid metrics interval" << std::endl;
+                return false;
+            }
+        } else if (arg == "--trace") {
+            const char* value = needValue("--trace");
+            if (!value) return false;
+            options.tracePath = value;
+        } else if (arg == "--perf-counters") {
+            options.perfCounters = true;
+        } else if (arg == "--memory-stats") {
+            options.memoryStats = true;
+        } else if (arg == "--serve") {
+            const char* value = needValue("--serve");
+            if (!value) return false;
+            options.serveSocketPath = value;
+        } else if (arg == "--background-share") {
+            const char* value = needValue("--background-share");
+            if (!value || !parseFloat(value, options.backgroundShare) || options.backgroundShare < 0.0f ||
+                options.backgroundShare > 1.0f) {
+                std::cerr << "Invalid background share (expected 0 <= x <= 1)" << std::endl;
+                return false;
+            }
+        } else if (arg == "--result-ring") {
+            const char* value = needValue("--result-ring");
+            if (!value) return false;
+            options.resultRing = value;
+        } else if (arg == "--max-buffer") {
+            const char* value = needValue("--max-buffer");
+            if (!value || !parseInt(value, options.maxBufferMiB) || options.maxBufferMiB < 1 ||
+                options.maxBufferMiB > long(std::numeric_limits<size_t>::max() >> 20)) {
+                std::cerr << "Invalid maximum buffer size" << std::endl;
+                return false;
+            }
+        } else if (arg == "--bench-presets") {
+            const char* value = needValue("--bench-presets");
+            if (!value) return false;
+            options.presetBenchTruthPath = value;
+        } else if (arg == "--bench-scaling") {
+            options.scalingBench = true;
+        } else if (arg == "--scaling-files") {
+            const char* value = needValue("--scaling-files");
+            if (!value || !parseInt(value, options.scalingFiles) || options.scalingFiles < 1) {
+                std::cerr << "Invalid file count" << std::endl;
+                return false;
+            }
+        } else if (arg == "--scaling-seconds") {
+            const char* value = needValue("--scaling-seconds");
+            if (!value || !parseFloat(value, options.scalingSeconds) || options.scalingSeconds <= 0.0f) {
+                std::cerr << "Invalid track length" << std::endl;
+                return false;
+            }
+        } else if (arg == "--scaling-dir") {
+            const char* value = needValue("--scaling-dir");
+            if (!value) return false;
+            options.scalingDirectory = value;
+        } else if (arg == "--bench-save") {
+            const char* value = needValue("--bench-save");
+            if (!value) return false;
+            options.gateSavePath = value;
+        } else if (arg == "--bench-compare") {
+            const char* value = needValue("--bench-compare");
+            if (!value) return false;
+            options.gateComparePath = value;
+        } else if (arg == "--bench-truth") {
+            const char* value = needValue("--bench-truth");
+            if (!value) return false;
+            options.gateTruthPath = value;
+        } else if (arg == "--repetitions") {
+            const char* value = needValue("--repetitions");
+            if (!value || !parseInt(value, options.gateRepetitions) || options.gateRepetitions < 2) {
+                std::cerr << "Invalid repetition count (need at least 2)" << std::endl;
+                return false;
+            }
+        } else if (arg == "--gate-threshold") {
+            const char* value = needValue("--gate-threshold");
+            if (!value || !parseFloat(value, options.gateThreshold) || options.gateThreshold < 0.0f) {
+                std::cerr << "Invalid gate threshold" << std::endl;
+                return false;
+            }
+        } else if (arg == "--tolerance") {
+            const char* value = needValue("--tolerance");
+            if (!value || !parseFloat(value, options.sweepTolerance) || options.sweepTolerance < 0.0f) {
+                std::cerr << "Invalid tolerance" << std::endl;
+                return false;
+            }
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        } else {
+            options.paths.push_back(arg);
+        }
     }
 
-    std::cout << "File opened successfully: " << filepath << std::endl;
+    int modes = !options.sweepTruthPath.empty() + !options.serveSocketPath.empty() +
+                !options.presetBenchTruthPath.empty() +
+                (!options.gateSavePath.empty() || !options.gateComparePath.empty()) + options.scalingBench;
+    if (modes > 1) {
+        std::cerr << "--sweep, --serve, --bench-presets, --bench-save/--bench-compare and --bench-scaling are "
+                     "mutually exclusive"
+                  << std::endl;
+        return false;
+    }
+    if (options.config.minBpm >= options.config.maxBpm) {
+        std::cerr << "--min-bpm must be below --max-bpm" << std::endl;
+        return false;
+    }
+    if (options.paths.empty() && !options.readStdin) {
+        options.paths.push_back((fs::current_path() / "test").string());
+    }
+    return true;
+}
 
-    std::vector<float> samples(sfinfo.frames * sfinfo.channels);
-    if (sf_readf_float(file, samples.data(), sfinfo.frames) != sfinfo.frames) {
-        std::lock_guard<std::mutex> guard(outputMutex);
-        std::cerr << "Error reading samples from " << filepath << std::endl;
-        sf_close(file);
-        return;
+bool isAudioFile(const fs::path& path) {
+    static const char* const extensions[] = {".wav", ".mp3", ".flac", ".aif", ".aiff", ".ogg"};
+    std::string extension = path.extension().string();
+    for (char& c : extension) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    for (const char* candidate : extensions) {
+        if (extension == candidate) return true;
     }
+    return false;
+}
 
-    std::cout << "Samples read successfully: " << filepath << std::endl;
-    sf_close(file);
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+        case '"': escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\t': escaped += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                escaped += buffer;
+            } else {
+                escaped += c;
+            }
+        }
+    }
+    return escaped;
 }
 
-void detectBpm(const std::string& filepath) {
-    if (!fs::exists(filepath)) {
-        std::lock_guard<std::mutex> guard(outputMutex);
-        std::cerr << "File not found: " << filepath << std::endl;
-        return;
+void printResult(const AnalysisResult& result, OutputFormat format) {
+    std::lock_guard<std::mutex> guard(outputMutex);
+    switch (format) {
+    case OutputFormat::Text:
+        std::cout << "Processing file: " << result.source << std::endl;
+        if (!result.ok) {
+            std::cerr << "Error processing " << result.source << ": " << result.error << std::endl;
+            return;
+        }
+        std::cout << "Detected BPM for " << result.source << ": " << result.bpm << std::endl;
+        break;
+    case OutputFormat::Tsv:
+        std::cout << result.source << '\t' << (result.ok ? "ok" : "error") << '\t' << result.bpm << '\t'
+                  << result.sampleRate << '\t' << result.channels << '\t' << result.frames << '\t'
+                  << result.error << '\n';
+        break;
+    case OutputFormat::Json:
+        std::cout << "{\"source\":\"" << jsonEscape(result.source) << "\",\"ok\":" << (result.ok ? "true" : "false")
+                  << ",\"bpm\":" << result.bpm << ",\"sampleRate\":" << result.sampleRate
+                  << ",\"channels\":" << result.channels << ",\"frames\":" << result.frames
+                  << ",\"peaks\":" << result.peakCount << ",\"allocatedBytes\":" << result.memory.allocatedBytes
+                  << ",\"allocations\":" << result.memory.allocations
+                  << ",\"peakLiveBytes\":" << result.memory.peakLiveBytes
+                  << ",\"residentBytes\":" << result.memory.residentBytes;
+        if (result.tempoCandidates[0].bpm > 0.0f) {
+            std::cout << ",\"alternatives\":[";
+            for (size_t i = 0; i < tempoCandidateCount && result.tempoCandidates[i].bpm > 0.0f; ++i) {
+                std::cout << (i ? "," : "") << "{\"bpm\":" << result.tempoCandidates[i].bpm
+                          << ",\"score\":" << result.tempoCandidates[i].score << "}";
+            }
+            std::cout << "]";
+        }
+        if (!result.ok) std::cout << ",\"error\":\"" << jsonEscape(result.error) << "\"";
+        std::cout << "}\n";
+        break;
     }
+}
 
-    SF_INFO sfinfo;
-    SNDFILE* file = sf_open(filepath.c_str(), SFM_READ, &sfinfo);
+// Announces an audio file found while scanning a directory, as the text
+// output always has.
+void reportFound(const fs::path& file, OutputFormat format) {
+    if (format != OutputFormat::Text) return;
+    std::lock_guard<std::mutex> guard(outputMutex);
+    std::cout << "Found: " << file.filename() << std::endl;
+}
 
-    if (!file) {
-        std::lock_guard<std::mutex> guard(outputMutex);
-        std::cerr << "Error opening file: " << filepath << std::endl;
-        std::cerr << "Libsndfile error: " << sf_strerror(file) << std::endl;
-        return;
+// Feeds a command-line path into the queue. Directories are expanded lazily so
+// huge trees never sit in memory as a whole.
+void enqueuePath(const std::string& path, bool recursive, OutputFormat format, WorkQueue<std::string>& queue) {
+    std::error_code ec;
+    if (fs::is_directory(path, ec)) {
+        auto options = fs::directory_options::skip_permission_denied;
+        if (recursive) {
+            for (auto it = fs::recursive_directory_iterator(path, options, ec);
+                 !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+                if (it->is_regular_file(ec) && isAudioFile(it->path())) {
+                    reportFound(it->path(), format);
+                    queue.push(it->path().string());
+                }
+            }
+        } else {
+            for (auto it = fs::directory_iterator(path, options, ec);
+                 !ec && it != fs::directory_iterator(); it.increment(ec)) {
+                if (it->is_regular_file(ec) && isAudioFile(it->path())) {
+                    reportFound(it->path(), format);
+                    queue.push(it->path().string());
+                }
+            }
+        }
+        if (ec) {
+            std::lock_guard<std::mutex> guard(outputMutex);
+            std::cerr << "Error scanning " << path << ": " << ec.message() << std::endl;
+        }
+    } else {
+        // Explicitly named files are analyzed regardless of extension.
+        queue.push(path);
     }
+}
 
-    std::cout << "Processing file: " << filepath << std::endl;
-
-    if (sfinfo.frames == 0 || sfinfo.channels == 0) {
-        std::lock_guard<std::mutex> guard(outputMutex);
-        std::cerr << "Invalid file: " << filepath << " (frames or channels is zero)" << std::endl;
-        sf_close(file);
-        return;
+int main(int argc, char** argv) {
+    CliOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 2;
     }
 
-    std::vector<float> samples(sfinfo.frames * sfinfo.channels);
-    if (sf_readf_float(file, samples.data(), sfinfo.frames) != sfinfo.frames) {
-        std::lock_guard<std::mutex> guard(outputMutex);
-        std::cerr << "Error reading samples from " << filepath << std::endl;
-        sf_close(file);
-        return;
+    MetricsExporter metricsExporter;
+    std::string metricsError;
+    if (!metricsExporter.start(options.metricsPort, options.metricsFile, options.metricsInterval, metricsError)) {
+        std::cerr << metricsError << std::endl;
+        return 1;
     }
-    sf_close(file);
 
-    if (sfinfo.channels > 1) {
-        std::vector<float> mono(samples.size() / sfinfo.channels);
-        for (size_t i = 0; i < mono.size(); ++i) {
-            mono[i] = (samples[i * sfinfo.channels] + samples[i * sfinfo.channels + 1]) / 2.0f;
+    if (!options.tracePath.empty()) enableTrace();
+    if (options.metricsPort > 0 || !options.metricsFile.empty()) enableTraceMetrics();
+    if (options.perfCounters) {
+        std::string perfError;
+        if (enablePerfCounters(perfError)) {
+            enableTraceCounters();
+        } else {
+            std::cerr << perfError << std::endl;
+            options.perfCounters = false;
         }
-        samples = mono;
     }
+    auto finishTrace = [&](int status) {
+        if (options.perfCounters) printPerfSummary(std::cerr);
+        std::string traceError;
+        if (!options.tracePath.empty() && !writeTrace(options.tracePath, traceError)) {
+            std::cerr << traceError << std::endl;
+            return status == 0 ? 1 : status;
+        }
+        return status;
+    };
 
-    std::vector<float> envelope(samples.size());
-    for (size_t i = 0; i < samples.size(); ++i) {
-        envelope[i] = std::abs(samples[i]);
+    if (!options.sweepTruthPath.empty()) {
+        SweepOptions sweep;
+        sweep.truthPath = options.sweepTruthPath;
+        sweep.grid = options.sweepGrid;
+        sweep.base = options.config;
+        sweep.threads = options.threads;
+        sweep.tolerance = options.sweepTolerance;
+        sweep.json = options.format == OutputFormat::Json;
+        return finishTrace(runSweep(sweep));
     }
 
-    const float smoothingFactor = 0.1f;
-    for (size_t i = 1; i < envelope.size(); ++i) {
-        envelope[i] = smoothingFactor * envelope[i] + (1.0f - smoothingFactor) * envelope[i - 1];
+    if (!options.serveSocketPath.empty()) {
+        ServerOptions server;
+        server.socketPath = options.serveSocketPath;
+        server.config = options.config;
+        server.threads = options.threads;
+        server.backgroundShare = options.backgroundShare;
+        server.resultRing = options.resultRing;
+        server.maxBufferBytes = static_cast<size_t>(options.maxBufferMiB) << 20;
+        return finishTrace(runServer(server));
     }
 
-    float threshold = 0.05f;
-    int minGap = 500;
+    if (!options.presetBenchTruthPath.empty()) {
+        PresetBenchOptions bench;
+        bench.truthPath = options.presetBenchTruthPath;
+        bench.base = options.config;
+        bench.threads = options.threads;
+        bench.tolerance = options.sweepTolerance;
+        bench.json = options.format == OutputFormat::Json;
+        return finishTrace(runPresetBenchmark(bench));
+    }
 
-    std::vector<int> peaks = detectPeaks(envelope, threshold, minGap);
+    if (!options.gateSavePath.empty() || !options.gateComparePath.empty()) {
+        GateBenchOptions gate;
+        gate.config = options.config;
+        gate.threads = options.threads;
+        gate.repetitions = static_cast<int>(options.gateRepetitions);
+        gate.truthPath = options.gateTruthPath;
+        gate.tolerance = options.sweepTolerance;
+        gate.threshold = options.gateThreshold;
+        gate.savePath = options.gateSavePath;
+        gate.comparePath = options.gateComparePath;
+        gate.json = options.format == OutputFormat::Json;
+        return finishTrace(runRegressionGate(gate));
+    }
 
-    float bpm = calculateBpm(peaks, sfinfo.samplerate) / 35;
+    if (options.scalingBench) {
+        ScalingBenchOptions bench;
+        bench.config = options.config;
+        bench.maxThreads = options.threads;
+        bench.files = static_cast<size_t>(options.scalingFiles);
+        bench.seconds = options.scalingSeconds;
+        bench.directory = options.scalingDirectory;
+        bench.json = options.format == OutputFormat::Json;
+        return finishTrace(runScalingBenchmark(bench));
+    }
 
-    std::lock_guard<std::mutex> guard(outputMutex);
-    std::cout << "Detected BPM for " << filepath << ": " << bpm << std::endl;
-}
+    const Analyzer analyzer(options.config);
+    WorkQueue<std::string> queue(options.threads * std::max<size_t>(64, 2 * options.batchFiles));
+    std::atomic<size_t> failures{0};
+    MemorySummary memorySummary(options.threads);
 
-int main() {
-std::string folder = (fs::current_path() / "test").string();
-    listWavFiles(folder);
+    Metrics& metrics = Metrics::instance();
+    metrics.setWorkerCount(options.threads);
+    metrics.registerGauge("bpm_queue_depth", "Paths waiting for a worker.", [&queue] { return double(queue.size()); });
 
     std::vector<std::thread> threads;
+    for (unsigned t = 0; t < options.threads; ++t) {
+        threads.emplace_back([&, t] {
+            using Clock = std::chrono::steady_clock;
+            setTraceThreadName("worker " + std::to_string(t));
+            AnalyzerState state;
+            auto report = [&](const std::string& path, const AnalysisResult& result) {
+                if (!result.ok) failures.fetch_add(1, std::memory_order_relaxed);
+                metrics.recordResult(result);
+                memorySummary.record(t, path, result.memory);
 
-    for (const auto& entry : fs::directory_iterator(folder)) {
-        if (entry.path().extension() == ".wav" || entry.path().extension() == ".mp3") {
-            detectBpm(entry.path().string());
+                auto outputStart = Clock::now();
+                {
+                    TraceScope outputTrace("output");
+                    printResult(result, options.format);
+                }
+                double outputSeconds = std::chrono::duration<double>(Clock::now() - outputStart).count();
+                metrics.recordStage(MetricStage::Output, outputSeconds);
+            };
+
+            if (options.batchFiles > 1) {
+                std::vector<std::string> paths;
+                std::vector<AnalysisResult> results;
+                while (queue.popBatch(paths, options.batchFiles)) {
+                    auto start = Clock::now();
+                    {
+                        TraceScope trace("batch");
+                        analyzer.analyzeBatch(paths, state, results);
+                    }
+                    for (size_t i = 0; i < paths.size(); ++i) report(paths[i], results[i]);
+                    metrics.addBusySeconds(std::chrono::duration<double>(Clock::now() - start).count());
+                }
+                return;
+            }
+
+            std::string path;
+            while (queue.pop(path)) {
+                auto start = Clock::now();
+                TraceScope trace("file", &path);
+                report(path, analyzer.analyzeFile(path, state));
+                metrics.addBusySeconds(std::chrono::duration<double>(Clock::now() - start).count());
+            }
+        });
+    }
+
+    setTraceThreadName("main");
+    {
+        // Covers time blocked on a full queue, too: gaps in the workers with
+        // this span still open mean enumeration, not analysis, is the bottleneck.
+        TraceScope trace("enumerate");
+        for (const auto& path : options.paths) {
+            enqueuePath(path, options.recursive, options.format, queue);
+        }
+        if (options.readStdin) {
+            std::string line;
+            while (std::getline(std::cin, line, options.stdinDelimiter)) {
+                if (!line.empty() && line.back() == '\r' && options.stdinDelimiter == '\n') line.pop_back();
+                if (!line.empty()) queue.push(line);
+            }
         }
     }
+    queue.close();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::cout.flush();
+    metricsExporter.stop();
+    metrics.unregisterGauge("bpm_queue_depth");
+    if (options.memoryStats) memorySummary.print(std::cerr);
 
-    return 0;
+    return finishTrace(failures.load() == 0 ? 0 : 1);
 }
@@ -0,0 +1,172 @@
+#include "memory_stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+namespace {
+
+struct ThreadHeap {
+    HeapCounters counters;  // of the innermost open scope
+    int depth = 0;          // open AllocationScopes; nothing is counted at zero
+};
+
+thread_local ThreadHeap heap;
+
+// Blocks are counted at their usable size so that frees balance allocations
+// without having to store the requested size.
+inline size_t blockSize(void* block) {
+#ifdef __APPLE__
+    return malloc_size(block);
+#else
+    return malloc_usable_size(block);
+#endif
+}
+
+inline void noteAllocation(void* block) {
+    if (heap.depth == 0) return;
+    HeapCounters& c = heap.counters;
+    int64_t size = static_cast<int64_t>(blockSize(block));
+    c.allocatedBytes += static_cast<uint64_t>(size);
+    ++c.allocations;
+    c.liveBytes += size;
+    c.peakLiveBytes = std::max(c.peakLiveBytes, c.liveBytes);
+}
+
+double mebibytes(uint64_t bytes) {
+    return double(bytes) / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+void* countedAllocate(std::size_t size) {
+    void* block = std::malloc(size ? size : 1);
+    if (block) noteAllocation(block);
+    return block;
+}
+
+void countedRelease(void* block) {
+    if (!block) return;
+    if (heap.depth != 0) heap.counters.liveBytes -= static_cast<int64_t>(blockSize(block));
+    std::free(block);
+}
+
+AllocationScope::AllocationScope(uint64_t retainedBytes) : retainedBytes_(retainedBytes), outer_(heap.counters) {
+    heap.counters = HeapCounters{};
+    ++heap.depth;
+}
+
+AllocationScope::~AllocationScope() {
+    --heap.depth;
+    heap.counters = outer_;
+}
+
+FileMemory AllocationScope::finish() const {
+    const HeapCounters& c = heap.counters;
+    FileMemory memory;
+    memory.allocatedBytes = c.allocatedBytes;
+    memory.allocations = c.allocations;
+    memory.peakLiveBytes = retainedBytes_ + static_cast<uint64_t>(std::max<int64_t>(0, c.peakLiveBytes));
+    memory.residentBytes = static_cast<uint64_t>(processResidentBytes());
+    return memory;
+}
+
+double processResidentBytes() {
+#ifdef __linux__
+    long pages = 0, resident = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        std::fclose(statm);
+    }
+    return double(resident) * double(sysconf(_SC_PAGESIZE));
+#else
+    // Peak rather than current RSS, but the closest portable figure.
+    return peakResidentBytes();
+#endif
+}
+
+double peakResidentBytes() {
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::atof(line.c_str() + 6) * 1024.0;
+    }
+#endif
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return double(usage.ru_maxrss);
+#else
+    return double(usage.ru_maxrss) * 1024.0;
+#endif
+}
+
+void resetPeakResidentBytes() {
+#ifdef __linux__
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+#endif
+}
+
+MemorySummary::MemorySummary(size_t workers) : workers_(workers) {}
+
+void MemorySummary::record(size_t worker, const std::string& path, const FileMemory& memory) {
+    Worker& w = workers_[worker];
+    ++w.files;
+    w.allocatedBytes += memory.allocatedBytes;
+    w.allocations += memory.allocations;
+    w.maxResidentBytes = std::max(w.maxResidentBytes, memory.residentBytes);
+
+    auto byPeak = [](const FilePeak& a, const FilePeak& b) { return a.memory.peakLiveBytes > b.memory.peakLiveBytes; };
+    if (w.largest.size() == topFiles && memory.peakLiveBytes <= w.largest.back().memory.peakLiveBytes) return;
+    FilePeak entry{path, memory};
+    w.largest.insert(std::upper_bound(w.largest.begin(), w.largest.end(), entry, byPeak), entry);
+    if (w.largest.size() > topFiles) w.largest.pop_back();
+}
+
+void MemorySummary::print(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+    out << "Memory (heap via operator new; peak = reused scratch + growth; RSS sampled after each file)\n"
+        << "By worker:\n"
+        << std::setw(10) << "worker" << std::setw(8) << "files" << std::setw(14) << "alloc MiB" << std::setw(12)
+        << "allocs" << std::setw(14) << "max peak MiB" << std::setw(13) << "max RSS MiB" << "\n";
+    std::vector<std::pair<size_t, FilePeak>> largest;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        const Worker& w = workers_[i];
+        if (w.files == 0) continue;
+        uint64_t maxPeak = w.largest.empty() ? 0 : w.largest.front().memory.peakLiveBytes;
+        out << std::setw(10) << i << std::setw(8) << w.files << std::setw(14) << mebibytes(w.allocatedBytes)
+            << std::setw(12) << w.allocations << std::setw(14) << mebibytes(maxPeak) << std::setw(13)
+            << mebibytes(w.maxResidentBytes) << "\n";
+        for (const FilePeak& file : w.largest) largest.push_back({i, file});
+    }
+
+    out << "Largest per-file peaks:\n"
+        << std::setw(10) << "peak MiB" << std::setw(12) << "alloc MiB" << std::setw(10) << "allocs" << std::setw(10)
+        << "RSS MiB" << std::setw(8) << "worker" << "  file\n";
+    size_t shown = std::min(topFiles, largest.size());
+    std::partial_sort(largest.begin(), largest.begin() + shown, largest.end(), [](const auto& a, const auto& b) {
+        return a.second.memory.peakLiveBytes > b.second.memory.peakLiveBytes;
+    });
+    for (size_t i = 0; i < shown; ++i) {
+        const FileMemory& m = largest[i].second.memory;
+        out << std::setw(10) << mebibytes(m.peakLiveBytes) << std::setw(12) << mebibytes(m.allocatedBytes)
+            << std::setw(10) << m.allocations << std::setw(10) << mebibytes(m.residentBytes) << std::setw(8)
+            << largest[i].first << "  " << largest[i].second.path << "\n";
+    }
+    out << "Process peak RSS: " << mebibytes(static_cast<uint64_t>(peakResidentBytes())) << " MiB\n";
+    out.flags(flags);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Heap accounting per analyzed file. Each thread counts its own allocations
+// while an AllocationScope is open. The counting operator new and delete live
+// in allocation_hooks.cpp, which only the executables link, so programs using
+// the library keep their own allocator; without the hooks every heap figure
+// is zero. Memory that libsndfile takes with malloc is only visible in
+// residentBytes.
+struct FileMemory {
+    uint64_t allocatedBytes = 0;  // bytes handed out by operator new during the analysis
+    uint64_t allocations = 0;
+    uint64_t peakLiveBytes = 0;   // scratch held on entry plus the highest net heap growth
+    uint64_t residentBytes = 0;   // process RSS sampled when the analysis finished
+};
+
+// The calling thread's counts for the innermost open AllocationScope.
+struct HeapCounters {
+    uint64_t allocatedBytes = 0;
+    uint64_t allocations = 0;
+    int64_t liveBytes = 0;
+    int64_t peakLiveBytes = 0;
+};
+
+// Counts the calling thread's allocations from construction until
+// finish(). An inner scope suspends the outer one: work it covers, such as
+// an interactive job run from a preemption point, is not charged to the
+// outer scope, which resumes its own counts when the inner one closes.
+class AllocationScope {
+public:
+    // `retainedBytes` is scratch memory already held by the caller that the
+    // work reuses; it is added to the peak.
+    explicit AllocationScope(uint64_t retainedBytes = 0);
+    ~AllocationScope();
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+    // Allocation figures so far plus an RSS sample.
+    FileMemory finish() const;
+
+private:
+    uint64_t retainedBytes_;
+    HeapCounters outer_;  // the enclosing scope's counts, restored on destruction
+};
+
+// Called by the replaced operator new and delete (allocation_hooks.cpp).
+void* countedAllocate(std::size_t size);
+void countedRelease(void* block);
+
+// Current and peak (high-water mark) resident set size of the process.
+double processResidentBytes();
+double peakResidentBytes();
+// Resets the kernel's peak-RSS counter to the current RSS, so a benchmark can
+// measure each run's own high-water mark. Linux only; elsewhere
+// peakResidentBytes() stays the process-wide peak.
+void resetPeakResidentBytes();
+
+// Collects FileMemory records by worker for the end-of-run summary. Each
+// worker must only record into its own slot.
+class MemorySummary {
+public:
+    explicit MemorySummary(size_t workers);
+
+    void record(size_t worker, const std::string& path, const FileMemory& memory);
+
+    // Per-worker totals, the files with the highest peak and the process
+    // peak RSS. Call once the workers are idle.
+    void print(std::ostream& out) const;
+
+private:
+    struct FilePeak {
+        std::string path;
+        FileMemory memory;
+    };
+
+    struct Worker {
+        uint64_t files = 0;
+        uint64_t allocatedBytes = 0;
+        uint64_t allocations = 0;
+        uint64_t maxResidentBytes = 0;
+        std::vector<FilePeak> largest;  // highest peakLiveBytes first, at most topFiles
+    };
+
+    static constexpr size_t topFiles = 10;
+
+    std::vector<Worker> workers_;
+};
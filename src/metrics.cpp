@@ -0,0 +1,230 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+
+// Upper bounds of the latency histogram buckets, in seconds; the last bucket is +Inf.
+const double bucketBounds[Metrics::bucketCount - 1] = {0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0, 5.0, 10.0};
+const char* const stageNames[] = {"decode", "analysis", "output", "envelope", "peaks", "tempo"};
+
+// Single-writer increment: no lock prefix needed, readers see a torn-free value.
+void bump(std::atomic<uint64_t>& counter, uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+} // namespace
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Shard& Metrics::localShard() {
+    thread_local Shard* shard = nullptr;
+    if (!shard) {
+        shard = new Shard();
+        std::lock_guard<std::mutex> guard(mutex_);
+        shards_.push_back(shard);
+    }
+    return *shard;
+}
+
+void Metrics::recordStage(MetricStage stage, double seconds) {
+    Shard& shard = localShard();
+    size_t bucket = 0;
+    while (bucket < bucketCount - 1 && seconds > bucketBounds[bucket]) ++bucket;
+    bump(shard.stageBuckets[size_t(stage)][bucket], 1);
+    bump(shard.stageNanoseconds[size_t(stage)], static_cast<uint64_t>(seconds * 1e9));
+}
+
+void Metrics::recordResult(const AnalysisResult& result) {
+    Shard& shard = localShard();
+    bump(result.ok ? shard.filesProcessed : shard.filesFailed, 1);
+    bump(shard.bytesRead, result.inputBytes);
+    if (result.ok && result.sampleRate > 0) {
+        bump(shard.audioMicroseconds, static_cast<uint64_t>(double(result.frames) * 1e6 / result.sampleRate));
+        recordStage(MetricStage::Decode, result.decodeSeconds);
+        recordStage(MetricStage::Analysis, result.analysisSeconds);
+    }
+}
+
+void Metrics::addBusySeconds(double seconds) {
+    bump(localShard().busyNanoseconds, static_cast<uint64_t>(seconds * 1e9));
+}
+
+void Metrics::registerGauge(const std::string& name, const std::string& help, std::function<double()> sample) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    gauges_.push_back({name, help, std::move(sample)});
+}
+
+void Metrics::unregisterGauge(const std::string& name) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    gauges_.erase(std::remove_if(gauges_.begin(), gauges_.end(), [&](const Gauge& g) { return g.name == name; }),
+                  gauges_.end());
+    renderDone_.wait(lock, [this] { return rendering_ == 0; });
+}
+
+std::string Metrics::render() {
+    uint64_t processed = 0, failed = 0, bytes = 0, audio = 0, busy = 0;
+    uint64_t buckets[size_t(MetricStage::Count)][bucketCount] = {};
+    uint64_t stageNanoseconds[size_t(MetricStage::Count)] = {};
+    std::vector<Gauge> gauges;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (const Shard* shard : shards_) {
+            processed += shard->filesProcessed.load(std::memory_order_relaxed);
+            failed += shard->filesFailed.load(std::memory_order_relaxed);
+            bytes += shard->bytesRead.load(std::memory_order_relaxed);
+            audio += shard->audioMicroseconds.load(std::memory_order_relaxed);
+            busy += shard->busyNanoseconds.load(std::memory_order_relaxed);
+            for (size_t s = 0; s < size_t(MetricStage::Count); ++s) {
+                stageNanoseconds[s] += shard->stageNanoseconds[s].load(std::memory_order_relaxed);
+                for (size_t b = 0; b < bucketCount; ++b) {
+                    buckets[s][b] += shard->stageBuckets[s][b].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        gauges = gauges_;
+        ++rendering_;
+    }
+
+    std::ostringstream out;
+    auto counter = [&](const char* name, const char* help, double value) {
+        out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << " counter\n" << name << ' ' << value << '\n';
+    };
+    auto gauge = [&](const std::string& name, const std::string& help, double value) {
+        out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << " gauge\n" << name << ' ' << value << '\n';
+    };
+
+    counter("bpm_files_processed_total", "Files analyzed successfully.", double(processed));
+    counter("bpm_files_failed_total", "Files that could not be analyzed.", double(failed));
+    counter("bpm_bytes_read_total", "Encoded input bytes read.", double(bytes));
+    counter("bpm_audio_seconds_total", "Seconds of audio analyzed.", audio / 1e6);
+    counter("bpm_worker_busy_seconds_total", "Time workers spent on jobs; divide its rate by bpm_workers "
+                                             "for utilization.", busy / 1e9);
+    gauge("bpm_workers", "Worker threads.", workers_.load(std::memory_order_relaxed));
+    gauge("process_resident_memory_bytes", "Resident set size.", processResidentBytes());
+
+    out << "# HELP bpm_stage_duration_seconds Time spent in each stage, per file or per DSP pass.\n"
+        << "# TYPE bpm_stage_duration_seconds histogram\n";
+    for (size_t s = 0; s < size_t(MetricStage::Count); ++s) {
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < bucketCount; ++b) {
+            cumulative += buckets[s][b];
+            out << "bpm_stage_duration_seconds_bucket{stage=\"" << stageNames[s] << "\",le=\"";
+            if (b + 1 < bucketCount) out << bucketBounds[b];
+            else out << "+Inf";
+            out << "\"} " << cumulative << '\n';
+        }
+        out << "bpm_stage_duration_seconds_sum{stage=\"" << stageNames[s] << "\"} " << stageNanoseconds[s] / 1e9
+            << '\n';
+        out << "bpm_stage_duration_seconds_count{stage=\"" << stageNames[s] << "\"} " << cumulative << '\n';
+    }
+
+    for (const Gauge& g : gauges) {
+        gauge(g.name, g.help, g.sample());
+    }
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        --rendering_;
+    }
+    renderDone_.notify_all();
+    return out.str();
+}
+
+bool MetricsExporter::start(int port, const std::string& filePath, double intervalSeconds, std::string& error) {
+    filePath_ = filePath;
+    intervalSeconds_ = intervalSeconds > 0.0 ? intervalSeconds : 10.0;
+
+    if (port > 0) {
+        listenFd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        if (listenFd_ < 0 || ::bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd_, 16) != 0) {
+            error = std::string("Cannot listen on 127.0.0.1:") + std::to_string(port) + ": " + std::strerror(errno);
+            if (listenFd_ >= 0) ::close(listenFd_);
+            listenFd_ = -1;
+            return false;
+        }
+    }
+
+    if (listenFd_ >= 0 || !filePath_.empty()) {
+        thread_ = std::thread([this] { run(); });
+    }
+    return true;
+}
+
+void MetricsExporter::stop() {
+    if (!thread_.joinable()) return;
+    stopping_ = true;
+    thread_.join();
+    if (listenFd_ >= 0) ::close(listenFd_);
+    listenFd_ = -1;
+    if (!filePath_.empty()) writeFile();
+}
+
+// Write-then-rename so scrapers never see a half-written file.
+void MetricsExporter::writeFile() {
+    std::string temporary = filePath_ + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        out << Metrics::instance().render();
+    }
+    std::rename(temporary.c_str(), filePath_.c_str());
+}
+
+void MetricsExporter::run() {
+    using Clock = std::chrono::steady_clock;
+    auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(intervalSeconds_));
+    auto nextWrite = Clock::now() + interval;
+
+    while (!stopping_) {
+        if (listenFd_ >= 0) {
+            pollfd pending{listenFd_, POLLIN, 0};
+            if (::poll(&pending, 1, 200) > 0) {
+                int client = ::accept(listenFd_, nullptr, nullptr);
+                if (client >= 0) {
+                    // A client that connects and never sends (or never reads)
+                    // must not stall the file writes or stop().
+                    timeval timeout{1, 0};
+                    ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                    ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                    // The request itself is irrelevant: every path returns the metrics.
+                    char request[1024];
+                    ssize_t ignored = ::recv(client, request, sizeof(request), 0);
+                    (void)ignored;
+                    std::string body = Metrics::instance().render();
+                    std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                           "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+                    ::send(client, response.data(), response.size(), MSG_NOSIGNAL);
+                    ::close(client);
+                }
+            }
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+
+        if (!filePath_.empty() && Clock::now() >= nextWrite) {
+            writeFile();
+            nextWrite = Clock::now() + interval;
+        }
+    }
+}
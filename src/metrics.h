@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "analyzer.h"
+
+// Decode, Analysis and Output are observed once per file. Envelope, Peaks and
+// Tempo come from the DSP stage scopes (see TraceScope): once per pass, where a
+// batch shares one envelope pass.
+enum class MetricStage { Decode, Analysis, Output, Envelope, Peaks, Tempo, Count };
+
+// Process-wide counters and latency histograms. Every thread updates its own
+// cache-line-aligned shard with plain relaxed stores (it is the only writer),
+// so recording never contends; shards are summed only when rendering.
+class Metrics {
+public:
+    static constexpr size_t bucketCount = 10;  // including +Inf
+
+    static Metrics& instance();
+
+    // Counts one analyzed file and its decode/analysis latencies.
+    void recordResult(const AnalysisResult& result);
+    void recordStage(MetricStage stage, double seconds);
+    void addBusySeconds(double seconds);
+
+    // Gauges are sampled at render time, e.g. queue depth. `name` must be a
+    // valid Prometheus metric name.
+    void registerGauge(const std::string& name, const std::string& help, std::function<double()> sample);
+    // Must be called before whatever the gauge samples is destroyed. Waits
+    // for renders in progress, which sample their copies of the gauges
+    // outside the lock.
+    void unregisterGauge(const std::string& name);
+    void setWorkerCount(unsigned workers) { workers_.store(workers, std::memory_order_relaxed); }
+
+    // Prometheus text exposition format, version 0.0.4.
+    std::string render();
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> filesProcessed{0};
+        std::atomic<uint64_t> filesFailed{0};
+        std::atomic<uint64_t> bytesRead{0};
+        std::atomic<uint64_t> audioMicroseconds{0};
+        std::atomic<uint64_t> busyNanoseconds{0};
+        std::atomic<uint64_t> stageBuckets[size_t(MetricStage::Count)][bucketCount] = {};
+        std::atomic<uint64_t> stageNanoseconds[size_t(MetricStage::Count)] = {};
+    };
+
+    struct Gauge {
+        std::string name;
+        std::string help;
+        std::function<double()> sample;
+    };
+
+    Shard& localShard();
+
+    std::mutex mutex_;
+    std::vector<Shard*> shards_;  // never freed: counters must survive their threads
+    std::vector<Gauge> gauges_;
+    unsigned rendering_ = 0;  // renders sampling gauges copied under mutex_
+    std::condition_variable renderDone_;
+    std::atomic<unsigned> workers_{0};
+};
+
+// Serves Metrics::render() over HTTP on 127.0.0.1 and/or rewrites a file
+// periodically. Both run on one background thread.
+class MetricsExporter {
+public:
+    ~MetricsExporter() { stop(); }
+
+    // `port` 0 disables HTTP; empty `filePath` disables the file. Returns false
+    // (with a message in `error`) if the listening socket cannot be opened.
+    bool start(int port, const std::string& filePath, double intervalSeconds, std::string& error);
+
+    // Writes the file a final time and joins the thread.
+    void stop();
+
+private:
+    void run();
+    void writeFile();
+
+    int listenFd_ = -1;
+    std::string filePath_;
+    double intervalSeconds_ = 10.0;
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+};
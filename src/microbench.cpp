@@ -0,0 +1,550 @@
+// Kernel microbenchmarks: each production DSP loop against its candidate
+// replacements, over buffers sized from L1- to DRAM-resident. Self-contained
+// (only the analysis library); run it pinned to one core on an idle machine.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "analyzer.h"
+#include "pipelines.h"
+#include "synth.h"
+
+namespace {
+
+constexpr float benchThreshold = 0.05f;
+constexpr int benchMinGap = 500;
+constexpr float benchSmoothing = 0.1f;
+constexpr size_t benchTileFrames = 32768;
+constexpr size_t benchFrequencies = 32;
+constexpr size_t benchHop = 512;
+
+// Inputs and outputs for one buffer size. `samples` is the mono length.
+struct Workspace {
+    size_t samples = 0;
+    std::vector<float> stereo;
+    std::vector<float> mono;
+    std::vector<float> silent;  // mono with most of it muted, so the envelope decays toward zero
+    std::vector<float> envelope;
+    std::vector<int64_t> peaks;
+    std::vector<float> out;
+    std::vector<float> tile;
+    std::vector<int64_t> peaksOut;
+    std::vector<double> positionsOut;
+    std::vector<float> onset;    // log-energy flux of mono, one frame per benchHop samples
+    std::vector<float> scratch;
+    float bpm = 0.0f;
+};
+
+enum class Output { Samples, Peaks, Bpm };
+
+struct Kernel {
+    const char* group;
+    const char* name;  // "scalar" is the baseline: the production loop or the one it replaced
+    Output output;
+    double bytesPerElement;  // memory traffic per element, read + write
+    void (*run)(Workspace&);
+};
+
+// --- Candidate kernels -------------------------------------------------------
+
+void downmixStereo(const float* interleaved, size_t frames, float* mono) {
+    for (size_t i = 0; i < frames; ++i) {
+        mono[i] = (interleaved[2 * i] + interleaved[2 * i + 1]) * 0.5f;
+    }
+}
+
+void rectifyMask(const float* in, size_t count, float* out) {
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t bits;
+        std::memcpy(&bits, &in[i], sizeof(bits));
+        bits &= 0x7fffffffu;
+        std::memcpy(&out[i], &bits, sizeof(bits));
+    }
+}
+
+// prev + a * (x - prev): one multiply per sample instead of two.
+void smoothFactored(float* values, size_t count, float smoothingFactor) {
+    float previous = count ? values[0] : 0.0f;
+    for (size_t i = 1; i < count; ++i) {
+        previous += smoothingFactor * (values[i] - previous);
+        values[i] = previous;
+    }
+}
+
+// smoothInPlace() before denormalGuard: over silence its state decays into
+// subnormals and stays on the smallest one.
+void smoothUnguarded(float* values, size_t count, float smoothingFactor) {
+    for (size_t i = 1; i < count; ++i) {
+        values[i] = smoothingFactor * values[i] + (1.0f - smoothingFactor) * values[i - 1];
+    }
+}
+
+// Rectify and smooth in one pass, so the envelope is written once.
+void envelopeFused(const float* in, size_t count, float smoothingFactor, float* out) {
+    if (!count) return;
+    float previous = std::abs(in[0]);
+    out[0] = previous;
+    for (size_t i = 1; i < count; ++i) {
+        previous = smoothingFactor * std::abs(in[i]) + (1.0f - smoothingFactor) * previous;
+        out[i] = previous;
+    }
+}
+
+// The original one-sample-at-a-time detectPeaks(), kept as the reference the
+// vectorized production version must match exactly.
+void detectPeaksScalar(const std::vector<float>& signal, float threshold, int minGap, std::vector<int64_t>& peaks) {
+    peaks.clear();
+    for (size_t i = 1; i + 1 < signal.size(); ++i) {
+        if (signal[i] > signal[i - 1] && signal[i] > signal[i + 1] && signal[i] > threshold) {
+            if (peaks.empty() || static_cast<int64_t>(i) - peaks.back() > minGap) {
+                peaks.push_back(i);
+            }
+        }
+    }
+}
+
+// Evaluates the local-maximum test without short-circuiting, so the common
+// "not a peak" case costs no unpredictable branches.
+void detectPeaksBranchless(const std::vector<float>& signal, float threshold, int minGap, std::vector<int64_t>& peaks) {
+    peaks.clear();
+    int64_t last = -int64_t(minGap) - 1;
+    for (size_t i = 1; i + 1 < signal.size(); ++i) {
+        bool candidate = (signal[i] > signal[i - 1]) & (signal[i] > signal[i + 1]) & (signal[i] > threshold);
+        if (candidate && static_cast<int64_t>(i) - last > minGap) {
+            peaks.push_back(static_cast<int64_t>(i));
+            last = static_cast<int64_t>(i);
+        }
+    }
+}
+
+// The sum of consecutive intervals telescopes to last - first.
+float calculateBpmEndpoints(const std::vector<int64_t>& peaks, int sampleRate) {
+    if (peaks.size() < 2) return 0.0f;
+    float average = static_cast<float>(peaks.back() - peaks.front()) / sampleRate / (peaks.size() - 1);
+    return 60.0f / average;
+}
+
+// goertzelPower() one frequency at a time: each sample waits on the
+// previous one through the recurrence.
+void goertzelSingle(const float* x, size_t n, const float* omegas, size_t count, float* power) {
+    for (size_t k = 0; k < count; ++k) {
+        float coeff = 2.0f * std::cos(omegas[k]), s1 = 0.0f, s2 = 0.0f;
+        for (size_t t = 0; t < n; ++t) {
+            float next = (x[t] - s2) + coeff * s1;
+            s2 = s1;
+            s1 = next;
+        }
+        power[k] = s1 * s1 + s2 * s2 - coeff * s1 * s2;
+    }
+}
+
+// A tempo refinement grid: benchFrequencies tempos 0.01 BPM apart around
+// 120 BPM, at 86 onset frames per second.
+const float* benchOmegas() {
+    static float omegas[benchFrequencies];
+    for (size_t k = 0; k < benchFrequencies; ++k) {
+        omegas[k] = static_cast<float>(2.0 * 3.14159265358979323846 * (120.0 + 0.01 * k) / 60.0 / 86.0);
+    }
+    return omegas;
+}
+
+const Kernel kernels[] = {
+    {"downmix", "scalar", Output::Samples, 12.0,
+     [](Workspace& w) { downmixToMono(w.stereo.data(), w.samples, 2, w.out.data()); }},
+    {"downmix", "stereo-stride", Output::Samples, 12.0,
+     [](Workspace& w) { downmixStereo(w.stereo.data(), w.samples, w.out.data()); }},
+
+    {"rectify", "scalar", Output::Samples, 8.0, [](Workspace& w) { rectify(w.mono.data(), w.samples, w.out.data()); }},
+    {"rectify", "sign-mask", Output::Samples, 8.0,
+     [](Workspace& w) { rectifyMask(w.mono.data(), w.samples, w.out.data()); }},
+
+    // Smoothing runs in place; starting from the rectified signal each time
+    // keeps the input identical across iterations.
+    {"smoothing", "scalar", Output::Samples, 16.0,
+     [](Workspace& w) {
+         std::copy(w.envelope.begin(), w.envelope.end(), w.out.begin());
+         smoothInPlace(w.out.data(), w.samples, benchSmoothing);
+     }},
+    {"smoothing", "factored", Output::Samples, 16.0,
+     [](Workspace& w) {
+         std::copy(w.envelope.begin(), w.envelope.end(), w.out.begin());
+         smoothFactored(w.out.data(), w.samples, benchSmoothing);
+     }},
+
+    {"envelope", "scalar", Output::Samples, 16.0,
+     [](Workspace& w) {
+         rectify(w.mono.data(), w.samples, w.out.data());
+         smoothInPlace(w.out.data(), w.samples, benchSmoothing);
+     }},
+    {"envelope", "fused", Output::Samples, 8.0,
+     [](Workspace& w) { envelopeFused(w.mono.data(), w.samples, benchSmoothing, w.out.data()); }},
+
+    {"detectPeaks", "scalar", Output::Peaks, 4.0,
+     [](Workspace& w) { detectPeaksScalar(w.envelope, benchThreshold, benchMinGap, w.peaksOut); }},
+    {"detectPeaks", "branchless", Output::Peaks, 4.0,
+     [](Workspace& w) { detectPeaksBranchless(w.envelope, benchThreshold, benchMinGap, w.peaksOut); }},
+    {"detectPeaks", "simd", Output::Peaks, 4.0,
+     [](Workspace& w) { detectPeaks(w.envelope, benchThreshold, benchMinGap, w.peaksOut); }},
+
+    // Envelopes of envelopeLanes equal slices of the signal, standing in for
+    // a batch of short files: one slice after another against all slices as
+    // SIMD lanes.
+    {"envelopeBatch", "scalar", Output::Samples, 8.0,
+     [](Workspace& w) {
+         size_t slice = w.samples / envelopeLanes;
+         for (size_t l = 0; l < envelopeLanes; ++l) {
+             rectify(w.mono.data() + l * slice, slice, w.out.data() + l * slice);
+             smoothInPlace(w.out.data() + l * slice, slice, benchSmoothing);
+         }
+     }},
+    {"envelopeBatch", "lanes", Output::Samples, 8.0,
+     [](Workspace& w) {
+         size_t slice = w.samples / envelopeLanes;
+         const float* mono[envelopeLanes];
+         float* envelope[envelopeLanes];
+         size_t lengths[envelopeLanes];
+         for (size_t l = 0; l < envelopeLanes; ++l) {
+             mono[l] = w.mono.data() + l * slice;
+             envelope[l] = w.out.data() + l * slice;
+             lengths[l] = slice;
+         }
+         computeEnvelopes(mono, lengths, envelopeLanes, benchSmoothing, envelope);
+     }},
+
+    // Power at benchFrequencies tempo frequencies, so times are per sample
+    // for all of them: one frequency after another against SIMD lanes.
+    {"goertzel", "scalar", Output::Samples, 4.0,
+     [](Workspace& w) { goertzelSingle(w.envelope.data(), w.samples, benchOmegas(), benchFrequencies, w.out.data()); }},
+    {"goertzel", "lanes", Output::Samples, 4.0,
+     [](Workspace& w) { goertzelPower(w.envelope.data(), w.samples, benchOmegas(), benchFrequencies, w.out.data()); }},
+
+    // The envelope of mostly silent audio, where the unguarded recurrence runs
+    // on subnormals: the guard or FTZ/DAZ each remove the slowdown.
+    {"silence", "scalar", Output::Samples, 16.0,
+     [](Workspace& w) {
+         rectify(w.silent.data(), w.samples, w.out.data());
+         smoothUnguarded(w.out.data(), w.samples, benchSmoothing);
+     }},
+    {"silence", "guard", Output::Samples, 16.0,
+     [](Workspace& w) {
+         rectify(w.silent.data(), w.samples, w.out.data());
+         smoothInPlace(w.out.data(), w.samples, benchSmoothing);
+     }},
+    {"silence", "ftz-daz", Output::Samples, 16.0,
+     [](Workspace& w) {
+         DenormalScope denormals(true);
+         rectify(w.silent.data(), w.samples, w.out.data());
+         smoothUnguarded(w.out.data(), w.samples, benchSmoothing);
+     }},
+
+    // The whole Legacy DSP chain from mono audio: whole-file passes against
+    // cache-sized tiles.
+    {"legacyStages", "scalar", Output::Peaks, 12.0,
+     [](Workspace& w) {
+         computeEnvelope(w.mono, benchSmoothing, w.tile);
+         detectPeaks(w.tile, benchThreshold, benchMinGap, w.peaksOut, w.positionsOut);
+     }},
+    {"legacyStages", "tiled", Output::Peaks, 4.0,
+     [](Workspace& w) {
+         PeakStream stream(benchSmoothing, benchThreshold, benchMinGap, w.tile, w.peaksOut, w.positionsOut);
+         for (size_t at = 0; at < w.samples; at += benchTileFrames) {
+             stream.push(w.mono.data() + at, std::min(benchTileFrames, w.samples - at));
+         }
+     }},
+
+    // Balanced's tempo search over the onset envelope of the signal, so times
+    // are per audio sample: every lag at full resolution against the
+    // decimated envelope and a few full-resolution lag windows.
+    {"tempoSearch", "scalar", Output::Bpm, 4.0 / benchHop,
+     [](Workspace& w) {
+         w.bpm = pipeline_detail::autocorrelationTempo(w.onset, 44100.0f / benchHop, 60.0f, 200.0f, {}, w.scratch);
+     }},
+    {"tempoSearch", "coarse-to-fine", Output::Bpm, 4.0 / benchHop,
+     [](Workspace& w) {
+         w.bpm = pipeline_detail::coarseToFineTempo(w.onset, 44100.0f / benchHop, 60.0f, 200.0f, {}, w.scratch);
+     }},
+
+    {"calculateBpm", "scalar", Output::Bpm, 4.0, [](Workspace& w) { w.bpm = calculateBpm(w.peaks, 44100); }},
+    {"calculateBpm", "endpoints", Output::Bpm, 4.0,
+     [](Workspace& w) { w.bpm = calculateBpmEndpoints(w.peaks, 44100); }},
+};
+
+// --- Harness -----------------------------------------------------------------
+
+struct SizeClass {
+    const char* label;
+    size_t bytes;  // of the mono buffer
+};
+
+const SizeClass sizeClasses[] = {
+    {"8 KiB (L1)", 8 << 10},
+    {"128 KiB (L2)", 128 << 10},
+    {"2 MiB (L3)", 2 << 20},
+    {"32 MiB (DRAM)", 32 << 20},
+};
+
+struct Options {
+    std::string filter;
+    int repetitions = 11;
+    double minSampleSeconds = 0.02;
+    int cpu = -1;
+    bool json = false;
+    std::string inputPath;  // real audio to use instead of the synthetic track
+};
+
+struct Measurement {
+    double nsPerElement = 0.0;  // median over repetitions
+    double bestNsPerElement = 0.0;
+    double spread = 0.0;  // median absolute deviation / median
+};
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --filter TEXT      only kernels whose group/name contains TEXT\n"
+              << "  --repetitions N    timed samples per kernel and size (default: 11)\n"
+              << "  --min-time MS      minimum duration of one sample (default: 20)\n"
+              << "  --cpu N            pin to CPU N (default: the CPU the harness starts on)\n"
+              << "  --input PATH       use this audio file as the signal (default: a synthetic track)\n"
+              << "  --json             machine-readable output\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        if (arg == "--filter") {
+            const char* v = value();
+            if (!v) return false;
+            options.filter = v;
+        } else if (arg == "--repetitions") {
+            const char* v = value();
+            if (!v || (options.repetitions = std::atoi(v)) < 1) return false;
+        } else if (arg == "--min-time") {
+            const char* v = value();
+            if (!v || std::atof(v) <= 0.0) return false;
+            options.minSampleSeconds = std::atof(v) / 1e3;
+        } else if (arg == "--cpu") {
+            const char* v = value();
+            if (!v || (options.cpu = std::atoi(v)) < 0) return false;
+        } else if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--input") {
+            const char* v = value();
+            if (!v) return false;
+            options.inputPath = v;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Pins the harness so samples are not split across cores with different
+// cache contents or clocks. Returns the CPU used, or -1 if not pinned.
+int pinToCpu(int cpu) {
+#ifdef __linux__
+    if (cpu < 0) cpu = sched_getcpu();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) return -1;
+    return cpu;
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+bool matchesFilter(const std::string& label, const std::string& filter) {
+    return filter.empty() || label.find(filter) != std::string::npos;
+}
+
+bool groupSelected(const char* group, const std::string& filter) {
+    for (const Kernel& kernel : kernels) {
+        if (std::strcmp(kernel.group, group) == 0 &&
+            matchesFilter(std::string(kernel.group) + "/" + kernel.name, filter)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void prepare(Workspace& w, size_t samples, const std::vector<float>& source) {
+    w.samples = samples;
+    w.stereo.resize(samples * 2);
+    for (size_t i = 0; i < w.stereo.size(); ++i) w.stereo[i] = source[i % source.size()];
+    w.mono.resize(samples);
+    downmixToMono(w.stereo.data(), samples, 2, w.mono.data());
+    // One 1024-sample burst in every 16384, the rest digital silence.
+    w.silent.assign(samples, 0.0f);
+    for (size_t i = 0; i < samples; ++i) {
+        if (i % 16384 < 1024) w.silent[i] = w.mono[i];
+    }
+    computeEnvelope(w.mono, benchSmoothing, w.envelope);
+    pipeline_detail::logEnergyFlux(w.mono, benchHop, w.onset);
+    // calculateBpm gets a peak list of the same length as the other inputs so
+    // every size class exercises the same memory level.
+    w.peaks.resize(samples);
+    for (size_t i = 0; i < samples; ++i) w.peaks[i] = static_cast<int64_t>(i * 3 + (i * 7919) % 3);
+    w.out.assign(samples, 0.0f);
+    w.peaksOut.clear();
+    w.peaksOut.reserve(samples);
+}
+
+double secondsFor(const Kernel& kernel, Workspace& w, size_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) kernel.run(w);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+Measurement measure(const Kernel& kernel, Workspace& w, const Options& options) {
+    // Calibrate: double the iteration count until one sample is long enough.
+    size_t iterations = 1;
+    while (secondsFor(kernel, w, iterations) < options.minSampleSeconds) iterations *= 2;
+
+    std::vector<double> samples;
+    for (int r = 0; r < options.repetitions; ++r) {
+        samples.push_back(secondsFor(kernel, w, iterations) * 1e9 / (double(iterations) * w.samples));
+    }
+    std::sort(samples.begin(), samples.end());
+    Measurement m;
+    m.nsPerElement = samples[samples.size() / 2];
+    m.bestNsPerElement = samples.front();
+    std::vector<double> deviations;
+    for (double s : samples) deviations.push_back(std::abs(s - m.nsPerElement));
+    std::sort(deviations.begin(), deviations.end());
+    m.spread = deviations[deviations.size() / 2] / m.nsPerElement;
+    return m;
+}
+
+// Largest difference from the baseline output, relative to its magnitude.
+// Peak lists must match exactly. Differences are reported, not fatal: a
+// candidate can be more accurate than the baseline (calculateBpm/endpoints).
+double outputError(Output output, const Workspace& w, const std::vector<float>& samples,
+                   const std::vector<int64_t>& peaks, float bpm) {
+    switch (output) {
+    case Output::Samples: {
+        double worst = 0.0, scale = 1e-30;
+        for (size_t i = 0; i < samples.size(); ++i) {
+            worst = std::max(worst, double(std::abs(w.out[i] - samples[i])));
+            scale = std::max(scale, double(std::abs(samples[i])));
+        }
+        return worst / scale;
+    }
+    case Output::Peaks: return w.peaksOut == peaks ? 0.0 : 1.0;
+    case Output::Bpm: return bpm != 0.0f ? std::abs(w.bpm - bpm) / std::abs(bpm) : std::abs(w.bpm);
+    }
+    return 1.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    int cpu = pinToCpu(options.cpu);
+    if (cpu < 0) std::cerr << "Warning: not pinned to a CPU; expect noisier results" << std::endl;
+
+    // Stereo source, repeated to fill each size class.
+    std::vector<float> source;
+    if (options.inputPath.empty()) {
+        SynthTrack track;
+        track.seconds = 10.0;
+        synthesizeTrack(track, source);
+    } else {
+        AnalyzerState state;
+        AnalysisResult decoded = Analyzer().decodeFile(options.inputPath, state);
+        if (!decoded.ok) {
+            std::cerr << "Cannot decode " << options.inputPath << ": " << decoded.error << std::endl;
+            return 1;
+        }
+        source.resize(state.samples.size() * 2);
+        for (size_t i = 0; i < state.samples.size(); ++i) source[2 * i] = source[2 * i + 1] = state.samples[i];
+    }
+
+    if (options.json) std::cout << "{\"cpu\":" << cpu << ",\"results\":[";
+    else std::cout << "Pinned to CPU " << cpu << "; " << options.repetitions << " samples of >= "
+                   << options.minSampleSeconds * 1e3 << " ms each\n";
+
+    bool firstResult = true;
+    for (const SizeClass& size : sizeClasses) {
+        Workspace w;
+        prepare(w, size.bytes / sizeof(float), source);
+        if (!options.json) {
+            std::cout << "\n" << size.label << "\n"
+                      << std::left << std::setw(26) << "  kernel" << std::right << std::setw(11) << "ns/elem"
+                      << std::setw(11) << "best" << std::setw(11) << "GB/s" << std::setw(9) << "spread"
+                      << std::setw(13) << "vs scalar" << std::setw(10) << "check" << "\n";
+        }
+
+        double baselineNs = 0.0;
+        std::vector<float> baselineSamples;
+        std::vector<int64_t> baselinePeaks;
+        float baselineBpm = 0.0f;
+        for (const Kernel& kernel : kernels) {
+            std::string label = std::string(kernel.group) + "/" + kernel.name;
+            bool baseline = std::strcmp(kernel.name, "scalar") == 0;
+            // A baseline runs whenever anything in its group does.
+            if (!matchesFilter(label, options.filter) && !(baseline && groupSelected(kernel.group, options.filter))) {
+                continue;
+            }
+
+            kernel.run(w);
+            double error = 0.0;
+            if (baseline) {
+                baselineSamples = w.out;
+                baselinePeaks = w.peaksOut;
+                baselineBpm = w.bpm;
+            } else {
+                error = outputError(kernel.output, w, baselineSamples, baselinePeaks, baselineBpm);
+            }
+            bool matches = error <= 1e-4;
+
+            Measurement m = measure(kernel, w, options);
+            if (baseline) baselineNs = m.nsPerElement;
+            double speedup = baselineNs > 0.0 ? baselineNs / m.nsPerElement : 1.0;
+            double gigabytesPerSecond = kernel.bytesPerElement / m.nsPerElement;
+
+            if (options.json) {
+                std::cout << (firstResult ? "" : ",") << "{\"kernel\":\"" << label << "\",\"size\":\"" << size.label
+                          << "\",\"bytes\":" << size.bytes << ",\"nsPerElement\":" << m.nsPerElement
+                          << ",\"bestNsPerElement\":" << m.bestNsPerElement << ",\"gbPerSecond\":"
+                          << gigabytesPerSecond << ",\"spread\":" << m.spread << ",\"speedup\":" << speedup
+                          << ",\"maxRelativeError\":" << error << ",\"matches\":" << (matches ? "true" : "false")
+                          << "}";
+                firstResult = false;
+            } else {
+                std::cout << std::left << std::setw(26) << ("  " + label) << std::right << std::fixed
+                          << std::setprecision(3) << std::setw(11) << m.nsPerElement << std::setw(11)
+                          << m.bestNsPerElement << std::setprecision(1) << std::setw(11) << gigabytesPerSecond
+                          << std::setw(8) << 100.0 * m.spread << "%" << std::setprecision(2) << std::setw(12)
+                          << speedup << "x";
+                if (matches) {
+                    std::cout << std::setw(10) << "ok";
+                } else {
+                    std::cout << std::scientific << std::setprecision(1) << std::setw(10) << error << std::fixed;
+                }
+                std::cout << "\n";
+            }
+        }
+    }
+    if (options.json) std::cout << "]}";
+    std::cout << std::endl;
+    return 0;
+}
@@ -0,0 +1,270 @@
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char* const counterNames[PerfCounterCount] = {"cycles", "instructions", "cache-misses", "branch-misses"};
+
+struct StageTotals {
+    const char* name;
+    uint64_t calls = 0;
+    PerfSample sum;
+};
+
+struct FileTotals {
+    std::string path;
+    PerfSample sum;
+};
+
+// Files listed in the summary. Each thread keeps only its own most expensive
+// ones, so a long-running daemon records a fixed amount per thread.
+constexpr size_t shownFiles = 10;
+
+// Heap order that keeps the cheapest retained file at the front.
+bool moreCycles(const FileTotals& a, const FileTotals& b) {
+    return a.sum.values[PerfCycles] > b.sum.values[PerfCycles];
+}
+
+struct PerfThread {
+    std::string name;
+    int fds[PerfCounterCount] = {-1, -1, -1, -1};
+    int slot[PerfCounterCount] = {-1, -1, -1, -1};  // position in the group read, -1 if unavailable
+    int opened = 0;
+    int openError = 0;
+    std::mutex mutex;  // only contended while printing the summary
+    std::vector<StageTotals> stages;
+    std::vector<FileTotals> files;  // heap of the shownFiles most expensive files
+    uint64_t fileCount = 0;
+    PerfSample fileSum;
+};
+
+std::mutex threadsMutex;
+std::vector<PerfThread*> threads;  // never freed: totals must survive their threads
+bool counterSeen[PerfCounterCount] = {};
+
+#ifdef __linux__
+int openCounter(uint32_t type, uint64_t config, int groupFd) {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+#endif
+
+void openCounters(PerfThread& thread) {
+#ifdef __linux__
+    const uint64_t configs[PerfCounterCount] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    int leader = -1;
+    for (int c = 0; c < PerfCounterCount; ++c) {
+        int fd = openCounter(PERF_TYPE_HARDWARE, configs[c], leader);
+        if (fd < 0) {
+            thread.openError = errno;
+            continue;
+        }
+        if (leader < 0) leader = fd;
+        thread.fds[c] = fd;
+        thread.slot[c] = thread.opened++;
+    }
+#else
+    (void)thread;
+#endif
+}
+
+PerfThread& localThread() {
+    thread_local PerfThread* thread = nullptr;
+    if (!thread) {
+        thread = new PerfThread();
+        openCounters(*thread);
+        std::lock_guard<std::mutex> guard(threadsMutex);
+        thread->name = "thread " + std::to_string(threads.size() + 1);
+        for (int c = 0; c < PerfCounterCount; ++c) {
+            if (thread->slot[c] >= 0) counterSeen[c] = true;
+        }
+        threads.push_back(thread);
+    }
+    return *thread;
+}
+
+void accumulate(PerfSample& total, const PerfSample& begin, const PerfSample& end) {
+    for (int c = 0; c < PerfCounterCount; ++c) total.values[c] += end.values[c] - begin.values[c];
+}
+
+void printRow(std::ostream& out, const std::string& label, uint64_t calls, const PerfSample& sum) {
+    char line[256];
+    auto counter = [&](int c, char* text, size_t size) {
+        if (!counterSeen[c]) std::snprintf(text, size, "n/a");
+        else std::snprintf(text, size, "%llu", static_cast<unsigned long long>(sum.values[c]));
+    };
+    char cycles[32], instructions[32];
+    counter(PerfCycles, cycles, sizeof(cycles));
+    counter(PerfInstructions, instructions, sizeof(instructions));
+
+    // Rates per thousand instructions make memory- vs compute-bound stages
+    // comparable regardless of how long they ran.
+    double kiloInstructions = sum.values[PerfInstructions] / 1e3;
+    auto rate = [&](int c, char* text, size_t size) {
+        if (!counterSeen[c] || !counterSeen[PerfInstructions] || kiloInstructions <= 0.0) {
+            std::snprintf(text, size, "n/a");
+        } else {
+            std::snprintf(text, size, "%.2f", sum.values[c] / kiloInstructions);
+        }
+    };
+    char ipc[32], cacheRate[32], branchRate[32];
+    if (counterSeen[PerfCycles] && counterSeen[PerfInstructions] && sum.values[PerfCycles] > 0) {
+        std::snprintf(ipc, sizeof(ipc), "%.2f", double(sum.values[PerfInstructions]) / sum.values[PerfCycles]);
+    } else {
+        std::snprintf(ipc, sizeof(ipc), "n/a");
+    }
+    rate(PerfCacheMisses, cacheRate, sizeof(cacheRate));
+    rate(PerfBranchMisses, branchRate, sizeof(branchRate));
+
+    std::snprintf(line, sizeof(line), "  %-28s %8llu %16s %16s %6s %10s %10s\n", label.c_str(),
+                  static_cast<unsigned long long>(calls), cycles, instructions, ipc, cacheRate, branchRate);
+    out << line;
+}
+
+void printHeader(std::ostream& out, const char* title) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "%s\n  %-28s %8s %16s %16s %6s %10s %10s\n", title, "", "calls", "cycles",
+                  "instructions", "IPC", "cm/kinst", "bm/kinst");
+    out << line;
+}
+
+} // namespace
+
+bool enablePerfCounters(std::string& error) {
+#ifdef __linux__
+    PerfThread& thread = localThread();
+    if (thread.opened == 0) {
+        error = std::string("Hardware counters unavailable (perf_event_open: ") + std::strerror(thread.openError) +
+                "); continuing without them";
+        return false;
+    }
+    return true;
+#else
+    error = "Hardware counters are only supported on Linux; continuing without them";
+    return false;
+#endif
+}
+
+void readPerfCounters(PerfSample& sample) {
+    PerfThread& thread = localThread();
+    if (thread.opened == 0) return;
+#ifdef __linux__
+    // Group read layout: nr, time_enabled, time_running, value[nr].
+    uint64_t buffer[3 + PerfCounterCount];
+    int leader = -1;
+    for (int c = 0; c < PerfCounterCount && leader < 0; ++c) leader = thread.fds[c];
+    if (::read(leader, buffer, sizeof(buffer)) <= 0) return;
+
+    // Scale up when the kernel multiplexed the group off the PMU for a while.
+    double scale = buffer[2] > 0 ? double(buffer[1]) / double(buffer[2]) : 1.0;
+    for (int c = 0; c < PerfCounterCount; ++c) {
+        if (thread.slot[c] >= 0) sample.values[c] = static_cast<uint64_t>(buffer[3 + thread.slot[c]] * scale);
+    }
+#endif
+}
+
+void recordPerfStage(const char* name, const std::string* detail, const PerfSample& begin) {
+    PerfSample end;
+    readPerfCounters(end);
+    PerfThread& thread = localThread();
+    std::lock_guard<std::mutex> guard(thread.mutex);
+
+    auto stage = std::find_if(thread.stages.begin(), thread.stages.end(),
+                              [name](const StageTotals& s) { return s.name == name; });
+    if (stage == thread.stages.end()) {
+        thread.stages.push_back({name, 0, {}});
+        stage = thread.stages.end() - 1;
+    }
+    ++stage->calls;
+    accumulate(stage->sum, begin, end);
+
+    if (detail) {
+        ++thread.fileCount;
+        accumulate(thread.fileSum, begin, end);
+        PerfSample sum;
+        accumulate(sum, begin, end);
+        std::vector<FileTotals>& files = thread.files;
+        if (files.size() < shownFiles) {
+            files.push_back({*detail, sum});
+            std::push_heap(files.begin(), files.end(), moreCycles);
+        } else if (sum.values[PerfCycles] > files.front().sum.values[PerfCycles]) {
+            std::pop_heap(files.begin(), files.end(), moreCycles);
+            files.back() = {*detail, sum};
+            std::push_heap(files.begin(), files.end(), moreCycles);
+        }
+    }
+}
+
+void setPerfThreadName(const std::string& name) {
+    PerfThread& thread = localThread();
+    std::lock_guard<std::mutex> guard(threadsMutex);
+    thread.name = name;
+}
+
+void printPerfSummary(std::ostream& out) {
+    std::lock_guard<std::mutex> guard(threadsMutex);
+
+    // The same stage name can come from several literals, so merge by text.
+    std::vector<std::pair<std::string, StageTotals>> stages;
+    std::vector<FileTotals> files;
+    for (PerfThread* thread : threads) {
+        std::lock_guard<std::mutex> threadGuard(thread->mutex);
+        for (const StageTotals& s : thread->stages) {
+            auto merged = std::find_if(stages.begin(), stages.end(),
+                                       [&](const auto& entry) { return entry.first == s.name; });
+            if (merged == stages.end()) {
+                stages.push_back({s.name, {s.name, 0, {}}});
+                merged = stages.end() - 1;
+            }
+            merged->second.calls += s.calls;
+            for (int c = 0; c < PerfCounterCount; ++c) merged->second.sum.values[c] += s.sum.values[c];
+        }
+        files.insert(files.end(), thread->files.begin(), thread->files.end());
+    }
+
+    out << "Hardware counters (user space; stages include nested stages;"
+        << " cm/bm = cache/branch misses per 1000 instructions)";
+    for (int c = 0; c < PerfCounterCount; ++c) {
+        if (!counterSeen[c]) out << "; " << counterNames[c] << " unavailable";
+    }
+    out << "\n";
+
+    printHeader(out, "By stage:");
+    std::sort(stages.begin(), stages.end(), [](const auto& a, const auto& b) {
+        return a.second.sum.values[PerfCycles] > b.second.sum.values[PerfCycles];
+    });
+    for (const auto& [name, totals] : stages) printRow(out, name, totals.calls, totals.sum);
+
+    printHeader(out, "By thread (per-file scopes):");
+    for (PerfThread* thread : threads) {
+        if (thread->fileCount > 0) printRow(out, thread->name, thread->fileCount, thread->fileSum);
+    }
+
+    printHeader(out, "Most expensive files:");
+    size_t shown = std::min(shownFiles, files.size());
+    std::partial_sort(files.begin(), files.begin() + shown, files.end(), moreCycles);
+    for (size_t i = 0; i < shown; ++i) {
+        const std::string& path = files[i].path;
+        std::string label = path.size() > 28 ? "..." + path.substr(path.size() - 25) : path;
+        printRow(out, label, 1, files[i].sum);
+    }
+}
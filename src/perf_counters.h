@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Per-thread hardware counters (Linux perf_event_open, user space only),
+// sampled at the same scopes as the trace timeline. Stage totals are
+// inclusive: "decode" also contains its "read" blocks. Scopes that carry a
+// detail (the file path) are the per-file unit.
+
+enum PerfCounter { PerfCycles, PerfInstructions, PerfCacheMisses, PerfBranchMisses, PerfCounterCount };
+
+struct PerfSample {
+    uint64_t values[PerfCounterCount] = {};
+};
+
+// Probes the counters on the calling thread. Returns false with the reason in
+// `error` when none are available (no PMU, perf_event_paranoid, non-Linux);
+// individual counters the CPU lacks are reported as n/a instead.
+bool enablePerfCounters(std::string& error);
+
+// Reads the calling thread's counters, opening them on first use. Counters
+// that could not be opened read as zero.
+void readPerfCounters(PerfSample& sample);
+
+void recordPerfStage(const char* name, const std::string* detail, const PerfSample& begin);
+void setPerfThreadName(const std::string& name);
+
+// Per-stage, per-thread and most expensive per-file totals. Call once the
+// recording threads are idle.
+void printPerfSummary(std::ostream& out);
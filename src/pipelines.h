@@ -0,0 +1,682 @@
+#pragma once
+
+// Preset pipelines. Each preset is a full specialization of Pipeline<> so the
+// stages it uses are resolved at compile time; Analyzer::analyzeDecoded()
+// switches on the preset (and for Legacy, on tiling) once per file and nothing
+// inside a pipeline branches on configuration. The onset presets also expose their onset() and tempo()
+// halves; tempo() only reads state.onset, so one onset envelope can serve
+// every configuration with the same hop size.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "analyzer.h"
+#include "trace.h"
+
+namespace pipeline_detail {
+
+// Lets a scheduler run urgent work between the onset and tempo stages, as it
+// does between decoded blocks (see AnalyzerState::blockHook).
+inline void stageBoundary(AnalyzerState& state) {
+    if (state.blockHook) state.blockHook();
+}
+
+// Mean absolute amplitude of each hop: a rectified, decimated envelope.
+inline void decimatedEnvelope(const std::vector<float>& mono, size_t hop, std::vector<float>& out) {
+    TraceScope trace("envelope", MetricStage::Envelope);
+    size_t frames = mono.size() / hop;
+    out.resize(frames);
+    for (size_t f = 0; f < frames; ++f) {
+        const float* x = mono.data() + f * hop;
+        float sum = 0.0f;
+        for (size_t i = 0; i < hop; ++i) sum += std::abs(x[i]);
+        out[f] = sum / hop;
+    }
+}
+
+// Replaces a per-hop level with its half-wave rectified first difference.
+inline void positiveDifference(std::vector<float>& values) {
+    for (size_t f = values.size(); f-- > 1;) {
+        values[f] = std::max(0.0f, values[f] - values[f - 1]);
+    }
+    if (!values.empty()) values[0] = 0.0f;
+}
+
+// Rectified first difference of log hop energy. This stands in for spectral
+// flux: it reacts to the same broadband onsets without needing an FFT.
+inline void logEnergyFlux(const std::vector<float>& mono, size_t hop, std::vector<float>& out) {
+    TraceScope trace("log energy flux", MetricStage::Envelope);
+    size_t frames = mono.size() / hop;
+    out.resize(frames);
+    for (size_t f = 0; f < frames; ++f) {
+        const float* x = mono.data() + f * hop;
+        float energy = 0.0f;
+        for (size_t i = 0; i < hop; ++i) energy += x[i] * x[i];
+        out[f] = std::log(1e-6f + energy / hop);
+    }
+    positiveDifference(out);
+}
+
+// Splits the signal into low (<150 Hz), mid and high (>2 kHz) bands with
+// one-pole filters and sums the per-band log-energy flux, so kick and hi-hat
+// onsets are not masked by sustained mid-range material. The filters see the
+// input plus denormalGuard, so their state settles instead of decaying into
+// subnormals over silence. Settled, the bands are a few ulps of the guard,
+// whose squares would be subnormal, so band values below 1e-18 count as zero.
+inline void multibandFlux(const std::vector<float>& mono, int sampleRate, size_t hop, std::vector<float>& bands,
+                          std::vector<float>& out) {
+    TraceScope trace("multiband flux", MetricStage::Envelope);
+    const float pi = 3.14159265f;
+    const float lowCoeff = 1.0f - std::exp(-2.0f * pi * 150.0f / sampleRate);
+    const float highCoeff = 1.0f - std::exp(-2.0f * pi * 2000.0f / sampleRate);
+    size_t frames = mono.size() / hop;
+    bands.assign(frames * 3, 0.0f);
+
+    float low = 0.0f, lowMid = 0.0f;
+    for (size_t f = 0; f < frames; ++f) {
+        const float* x = mono.data() + f * hop;
+        float lowEnergy = 0.0f, midEnergy = 0.0f, highEnergy = 0.0f;
+        for (size_t i = 0; i < hop; ++i) {
+            float in = x[i] + denormalGuard;
+            low += lowCoeff * (in - low);
+            lowMid += highCoeff * (in - lowMid);
+            float lowBand = std::abs(low) < 1e-18f ? 0.0f : low;
+            float mid = lowMid - low;
+            mid = std::abs(mid) < 1e-18f ? 0.0f : mid;
+            float high = in - lowMid;
+            high = std::abs(high) < 1e-18f ? 0.0f : high;
+            lowEnergy += lowBand * lowBand;
+            midEnergy += mid * mid;
+            highEnergy += high * high;
+        }
+        bands[f] = std::log(1e-6f + lowEnergy / hop);
+        bands[frames + f] = std::log(1e-6f + midEnergy / hop);
+        bands[2 * frames + f] = std::log(1e-6f + highEnergy / hop);
+    }
+
+    out.assign(frames, 0.0f);
+    for (size_t b = 0; b < 3; ++b) {
+        const float* band = bands.data() + b * frames;
+        for (size_t f = 1; f < frames; ++f) {
+            out[f] += std::max(0.0f, band[f] - band[f - 1]);
+        }
+    }
+}
+
+// Weight favouring tempos near 120 BPM, falling off by octave. Breaks ties
+// between a tempo and its multiples, which score alike in autocorrelation.
+inline float tempoWeight(float bpm) {
+    float octaves = std::log2(bpm / 120.0f);
+    return std::exp(-0.5f * octaves * octaves);
+}
+
+// Weight of a tempo under a genre prior: 1 inside the range, then falling
+// off with a half-octave standard deviation. tempoWeight() without a range.
+inline float priorWeight(float bpm, const TempoPrior& prior) {
+    if (prior.maxBpm <= 0.0f) return tempoWeight(bpm);
+    float octaves = 0.0f;
+    if (bpm < prior.minBpm) octaves = std::log2(prior.minBpm / bpm);
+    else if (bpm > prior.maxBpm) octaves = std::log2(bpm / prior.maxBpm);
+    return std::exp(-2.0f * octaves * octaves);
+}
+
+// Mean product of `centered` with itself `lag` frames later.
+inline float lagProduct(const float* centered, size_t n, size_t lag) {
+    double sum = 0.0;
+    for (size_t i = 0; i + lag < n; ++i) sum += centered[i] * centered[i + lag];
+    return static_cast<float>(sum / (n - lag));
+}
+
+// Subtracts the mean of `onset` into `centered`, which holds onset.size().
+inline void centerOnset(const std::vector<float>& onset, float* centered) {
+    double mean = 0.0;
+    for (float v : onset) mean += v;
+    mean /= onset.size();
+    for (size_t i = 0; i < onset.size(); ++i) centered[i] = onset[i] - static_cast<float>(mean);
+}
+
+// Picks the onset-envelope autocorrelation lag with the highest prior-weighted
+// score in [minBpm, maxBpm] and refines it with parabolic interpolation.
+inline float autocorrelationTempo(const std::vector<float>& onset, float framesPerSecond, float minBpm, float maxBpm,
+                                  const TempoPrior& prior, std::vector<float>& scratch) {
+    TraceScope trace("autocorrelation tempo");
+    size_t n = onset.size();
+    size_t minLag = std::max<size_t>(1, static_cast<size_t>(std::floor(framesPerSecond * 60.0f / maxBpm)));
+    size_t maxLag = static_cast<size_t>(std::ceil(framesPerSecond * 60.0f / minBpm));
+    if (n < 4 || minLag + 2 >= n) return 0.0f;
+    maxLag = std::min(maxLag, n - 2);
+
+    scratch.resize(n + maxLag + 2);
+    float* centered = scratch.data();
+    float* score = scratch.data() + n;
+    centerOnset(onset, centered);
+
+    size_t best = 0;
+    for (size_t lag = minLag - 1; lag <= maxLag + 1; ++lag) {
+        score[lag - (minLag - 1)] =
+            lagProduct(centered, n, lag) * priorWeight(60.0f * framesPerSecond / lag, prior);
+        if (lag >= minLag && lag <= maxLag && (best == 0 || score[lag - (minLag - 1)] > score[best - (minLag - 1)])) {
+            best = lag;
+        }
+    }
+    if (best == 0) return 0.0f;
+
+    float left = score[best - minLag], center = score[best - minLag + 1], right = score[best - minLag + 2];
+    float denom = left - 2.0f * center + right;
+    float offset = denom < 0.0f ? 0.5f * (left - right) / denom : 0.0f;
+    return 60.0f * framesPerSecond / (best + std::clamp(offset, -0.5f, 0.5f));
+}
+
+// autocorrelationTempo() searched coarse to fine. The whole lag range is
+// scored on the onset envelope averaged over coarseDecimation frames, where
+// there are 1/coarseDecimation as many lags, each over as many fewer frames.
+// Only lags within one coarse step of the coarseCandidates best local maxima
+// are then scored at full resolution. That is under half the multiply-adds,
+// and the lag is the same as the full search's whenever its maximum is near
+// one of the candidates. Envelopes shorter than two periods at minBpm, where
+// the coarse scores are too noisy, get the full search.
+constexpr size_t coarseDecimation = 4;
+constexpr size_t coarseCandidates = 3;
+inline float coarseToFineTempo(const std::vector<float>& onset, float framesPerSecond, float minBpm, float maxBpm,
+                               const TempoPrior& prior, std::vector<float>& scratch) {
+    const size_t n = onset.size(), m = n / coarseDecimation;
+    const float coarseFramesPerSecond = framesPerSecond / coarseDecimation;
+    size_t coarseMin = std::max<size_t>(1, static_cast<size_t>(std::floor(coarseFramesPerSecond * 60.0f / maxBpm)));
+    size_t coarseMax = static_cast<size_t>(std::ceil(coarseFramesPerSecond * 60.0f / minBpm));
+    if (m < 2 * coarseMax || coarseMin + 2 >= m) {
+        return autocorrelationTempo(onset, framesPerSecond, minBpm, maxBpm, prior, scratch);
+    }
+    TraceScope trace("coarse-to-fine tempo");
+    coarseMax = std::min(coarseMax, m - 2);
+    size_t minLag = std::max<size_t>(1, static_cast<size_t>(std::floor(framesPerSecond * 60.0f / maxBpm)));
+    size_t maxLag = std::min(static_cast<size_t>(std::ceil(framesPerSecond * 60.0f / minBpm)), n - 2);
+
+    // Fine scores cover lags minLag - 1 to maxLag + 1, like the full search;
+    // `unscored` marks the ones not computed.
+    const size_t fineCount = maxLag - minLag + 3;
+    scratch.resize(n + m + (coarseMax + 2) + fineCount);
+    float* centered = scratch.data();
+    float* decimated = centered + n;
+    float* coarse = decimated + m;
+    float* fine = coarse + coarseMax + 2;
+    centerOnset(onset, centered);
+    for (size_t j = 0; j < m; ++j) {
+        float sum = 0.0f;
+        for (size_t k = 0; k < coarseDecimation; ++k) sum += centered[j * coarseDecimation + k];
+        decimated[j] = sum / coarseDecimation;
+    }
+
+    for (size_t lag = coarseMin - 1; lag <= coarseMax + 1; ++lag) {
+        float bpm = 60.0f * coarseFramesPerSecond / std::max<size_t>(lag, 1);
+        coarse[lag] = lag == 0 ? 0.0f : lagProduct(decimated, m, lag) * priorWeight(bpm, prior);
+    }
+    // Best local maxima of the coarse scores, highest first.
+    size_t candidates[coarseCandidates];
+    size_t found = 0;
+    for (size_t lag = coarseMin; lag <= coarseMax; ++lag) {
+        if (coarse[lag] < coarse[lag - 1] || coarse[lag] < coarse[lag + 1]) continue;
+        size_t at = std::min(found, coarseCandidates);
+        while (at > 0 && coarse[candidates[at - 1]] < coarse[lag]) {
+            if (at < coarseCandidates) candidates[at] = candidates[at - 1];
+            --at;
+        }
+        if (at < coarseCandidates) {
+            candidates[at] = lag;
+            found = std::min(found + 1, coarseCandidates);
+        }
+    }
+    // A monotonic score has its maximum on an edge of the range.
+    if (found == 0) candidates[found++] = coarse[coarseMin] >= coarse[coarseMax] ? coarseMin : coarseMax;
+
+    const float unscored = std::numeric_limits<float>::lowest();
+    std::fill(fine, fine + fineCount, unscored);
+    auto score = [&](size_t lag) {
+        float& slot = fine[lag - (minLag - 1)];
+        if (slot == unscored) slot = lagProduct(centered, n, lag) * priorWeight(60.0f * framesPerSecond / lag, prior);
+        return slot;
+    };
+    size_t best = 0;
+    for (size_t c = 0; c < found; ++c) {
+        size_t centre = candidates[c] * coarseDecimation;
+        size_t from = std::max(minLag, centre > coarseDecimation ? centre - coarseDecimation : 0);
+        size_t to = std::min(maxLag, centre + coarseDecimation);
+        for (size_t lag = from; lag <= to; ++lag) {
+            if (best == 0 || score(lag) > score(best)) best = lag;
+        }
+    }
+    if (best == 0) return 0.0f;
+
+    float left = score(best - 1), center = score(best), right = score(best + 1);
+    float denom = left - 2.0f * center + right;
+    float offset = denom < 0.0f ? 0.5f * (left - right) / denom : 0.0f;
+    return 60.0f * framesPerSecond / (best + std::clamp(offset, -0.5f, 0.5f));
+}
+
+// Inter-onset interval histogram: onsets are local maxima above mean + one
+// standard deviation, refined to sub-hop `positions` by parabolicOffset().
+// Intervals to the next four onsets are folded into the tempo range by
+// octaves and voted into 1 BPM bins; the tempo is the weighted mean of the
+// votes in the best bin and its neighbours, so it is not quantized to bins.
+inline float histogramTempo(const std::vector<float>& onset, float framesPerSecond, float minBpm, float maxBpm,
+                            const TempoPrior& prior, std::vector<int>& onsets, std::vector<double>& positions,
+                            std::vector<float>& histogram) {
+    TraceScope trace("histogram tempo");
+    onsets.clear();
+    positions.clear();
+    size_t n = onset.size();
+    if (n < 3) return 0.0f;
+
+    double mean = 0.0, squares = 0.0;
+    for (float v : onset) {
+        mean += v;
+        squares += double(v) * v;
+    }
+    mean /= n;
+    float threshold = static_cast<float>(mean + std::sqrt(std::max(0.0, squares / n - mean * mean)));
+    for (size_t i = 1; i + 1 < n; ++i) {
+        if (onset[i] > threshold && onset[i] >= onset[i - 1] && onset[i] > onset[i + 1]) {
+            onsets.push_back(static_cast<int>(i));
+            positions.push_back(i + parabolicOffset(onset[i - 1], onset[i], onset[i + 1]));
+        }
+    }
+
+    // Vote weights per bin, then the sum of weight * bpm per bin. Folded
+    // tempos lie in [minBpm, maxBpm + 1), which spans ceil(maxBpm - minBpm) + 1
+    // bins when the range is not a whole number of BPM.
+    size_t bins = static_cast<size_t>(std::ceil(maxBpm - minBpm)) + 1;
+    histogram.assign(2 * bins, 0.0f);
+    float* votes = histogram.data();
+    float* weightedBpm = histogram.data() + bins;
+    for (size_t i = 0; i < positions.size(); ++i) {
+        for (size_t j = i + 1; j < positions.size() && j <= i + 4; ++j) {
+            float bpm = static_cast<float>(60.0 * framesPerSecond / (positions[j] - positions[i]));
+            while (bpm < minBpm) bpm *= 2.0f;
+            while (bpm >= maxBpm + 1.0f) bpm *= 0.5f;
+            if (bpm < minBpm) continue;
+            float vote = priorWeight(bpm, prior) / (j - i);
+            size_t bin = std::min(static_cast<size_t>(bpm - minBpm), bins - 1);
+            votes[bin] += vote;
+            weightedBpm[bin] += vote * bpm;
+        }
+    }
+
+    size_t best = std::max_element(votes, votes + bins) - votes;
+    if (votes[best] <= 0.0f) return 0.0f;
+    float weight = 0.0f, weighted = 0.0f;
+    for (size_t b = best > 0 ? best - 1 : 0; b <= std::min(bins - 1, best + 1); ++b) {
+        weight += votes[b];
+        weighted += weightedBpm[b];
+    }
+    return weighted / weight;
+}
+
+// Dynamic-programming beat tracker (Ellis 2007): each frame's score is its
+// onset strength plus the best predecessor score, penalized by how far the
+// gap deviates from the expected period. Beats are recovered by backtracking
+// and the tempo is re-estimated from a least-squares fit of beat positions,
+// refined to sub-hop `positions` by parabolicOffset(). Back links are stored
+// as the gap to the predecessor, which stays exact in a float however long
+// the signal is.
+inline float trackBeats(const std::vector<float>& onset, float framesPerSecond, float bpm, std::vector<float>& scratch,
+                        std::vector<int>& beats, std::vector<double>& positions) {
+    TraceScope trace("beat tracking");
+    beats.clear();
+    positions.clear();
+    size_t n = onset.size();
+    float period = 60.0f * framesPerSecond / bpm;
+    if (bpm <= 0.0f || n < 2 * period) return bpm;
+
+    double squares = 0.0;
+    for (float v : onset) squares += double(v) * v;
+    float scale = squares > 0.0 ? static_cast<float>(1.0 / std::sqrt(squares / n)) : 1.0f;
+
+    const float tightness = 100.0f;
+    const size_t maxGap = static_cast<size_t>(2 * period);
+    const size_t minGap = static_cast<size_t>(period / 2);
+    scratch.resize(2 * n + maxGap + 1);
+    float* score = scratch.data();
+    float* backlink = scratch.data() + n;  // gap to the predecessor, 0 for none
+    // The transition penalty depends only on the gap, so tabulate it once
+    // instead of calling log() for every candidate predecessor.
+    float* penalty = scratch.data() + 2 * n;
+    for (size_t gap = 1; gap <= maxGap; ++gap) {
+        float deviation = std::log(gap / period);
+        penalty[gap] = tightness * deviation * deviation;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        float local = onset[i] * scale;
+        float bestPrev = 0.0f;
+        backlink[i] = 0.0f;
+        size_t from = i >= maxGap ? i - maxGap : 0;
+        size_t to = i >= minGap ? i - minGap : 0;
+        for (size_t j = from; j < to; ++j) {
+            float candidate = score[j] - penalty[i - j];
+            if (backlink[i] == 0.0f || candidate > bestPrev) {
+                bestPrev = candidate;
+                backlink[i] = static_cast<float>(i - j);
+            }
+        }
+        // A chain that only loses score is not worth extending; start afresh.
+        if (bestPrev <= 0.0f) backlink[i] = 0.0f;
+        score[i] = local + std::max(0.0f, bestPrev);
+    }
+
+    size_t tailStart = n - static_cast<size_t>(period);
+    size_t last = std::max_element(score + tailStart, score + n) - score;
+    for (size_t at = last;; at -= static_cast<size_t>(backlink[at])) {
+        beats.push_back(static_cast<int>(at));
+        if (backlink[at] == 0.0f) break;
+    }
+    std::reverse(beats.begin(), beats.end());
+    for (int at : beats) {
+        float left = at > 0 ? onset[at - 1] : onset[at];
+        float right = at + 1 < static_cast<int>(n) ? onset[at + 1] : onset[at];
+        positions.push_back(at + parabolicOffset(left, onset[at], right));
+    }
+    if (beats.size() < 4) return bpm;
+
+    double count = static_cast<double>(positions.size());
+    double sumK = 0.0, sumX = 0.0, sumKK = 0.0, sumKX = 0.0;
+    for (size_t k = 0; k < positions.size(); ++k) {
+        sumK += k;
+        sumX += positions[k];
+        sumKK += double(k) * k;
+        sumKX += double(k) * positions[k];
+    }
+    double slope = (count * sumKX - sumK * sumX) / (count * sumKK - sumK * sumK);
+    return slope > 0.0 ? static_cast<float>(60.0 * framesPerSecond / slope) : bpm;
+}
+
+// Offset in [0, period) whose comb of onset samples k * period + offset has
+// the most energy: the beat phase for pipelines without a beat tracker.
+inline size_t beatPhase(const std::vector<float>& onset, float periodFrames) {
+    TraceScope trace("beat phase");
+    size_t period = static_cast<size_t>(periodFrames + 0.5f);
+    if (period == 0 || onset.size() < period) return 0;
+    size_t best = 0;
+    float bestSum = -1.0f;
+    for (size_t offset = 0; offset < period; ++offset) {
+        // Positions are accumulated in double: a float drifts by whole frames
+        // after a few million.
+        float sum = 0.0f;
+        for (double at = static_cast<double>(offset); at < onset.size(); at += periodFrames) {
+            sum += onset[static_cast<size_t>(at)];
+        }
+        if (sum > bestSum) {
+            bestSum = sum;
+            best = offset;
+        }
+    }
+    return best;
+}
+
+// How well a pulse train of period `periodFrames` explains the onset
+// envelope: the mean onset strength above `mean` at the pulses, at the best
+// phase, squared and divided by the period. Half the true tempo hits every
+// other beat and leaves the rest unexplained; double the tempo explains every
+// beat but half its pulses land on nothing. Either scores about half of the
+// true tempo, which autocorrelation alone cannot tell apart. The phase is
+// chosen afresh in every window of `windowFrames`, so a slightly wrong period
+// or a tempo ramp does not walk the pulses off the beats over a long file,
+// and each pulse takes the strongest frame within 1/16 period.
+inline float pulseScore(const std::vector<float>& onset, float mean, float periodFrames, size_t windowFrames) {
+    size_t period = static_cast<size_t>(periodFrames + 0.5f);
+    size_t n = onset.size();
+    if (period == 0 || n < 2 * period) return 0.0f;
+    size_t reach = period / 16;
+    windowFrames = std::clamp(windowFrames, 2 * period, n);
+    double total = 0.0;
+    size_t windows = 0;
+    for (size_t begin = 0; begin + windowFrames <= n; begin += windowFrames) {
+        double best = 0.0;
+        for (size_t offset = 0; offset < period; ++offset) {
+            double sum = 0.0;
+            size_t pulses = 0;
+            for (double at = static_cast<double>(begin + offset); at < begin + windowFrames; at += periodFrames) {
+                size_t i = static_cast<size_t>(at);
+                size_t from = i >= reach ? i - reach : 0, to = std::min(n, i + reach + 1);
+                sum += *std::max_element(onset.begin() + from, onset.begin() + to);
+                ++pulses;
+            }
+            best = std::max(best, sum / pulses - mean);
+        }
+        total += best;
+        ++windows;
+    }
+    double strength = total / windows;
+    return static_cast<float>(strength * strength / periodFrames);
+}
+
+// Octave-error correction: weighs 1x, 2x, 0.5x, 1.5x and 2/3x of `bpm` by
+// pulseScore() and the prior, and returns the best. Each candidate period may
+// stretch by 0.75% either way to absorb the error of the estimate itself.
+// `candidates` receives them best first, scored relative to the best; those
+// outside [minBpm, maxBpm] other than `bpm` itself are left out.
+inline float resolveTempo(const std::vector<float>& onset, float framesPerSecond, float bpm, float minBpm,
+                          float maxBpm, const TempoPrior& prior,
+                          std::array<TempoCandidate, tempoCandidateCount>& candidates) {
+    TraceScope trace("resolve tempo");
+    candidates = {};
+    if (bpm <= 0.0f || onset.empty()) return bpm;
+    static const float factors[tempoCandidateCount] = {1.0f, 2.0f, 0.5f, 1.5f, 2.0f / 3.0f};
+
+    double mean = 0.0;
+    for (float v : onset) mean += v;
+    mean /= onset.size();
+
+    // Every candidate is scored over the same windows, four periods of the
+    // slowest one.
+    size_t window = static_cast<size_t>(std::ceil(4.0f * 60.0f * framesPerSecond / (0.5f * bpm)));
+    size_t count = 0;
+    for (float factor : factors) {
+        float candidate = bpm * factor;
+        if (factor != 1.0f && (candidate < minBpm || candidate > maxBpm)) continue;
+        float periodFrames = 60.0f * framesPerSecond / candidate;
+        float periodic = 0.0f;
+        for (float stretch : {0.9925f, 1.0f, 1.0075f}) {
+            periodic = std::max(periodic, pulseScore(onset, static_cast<float>(mean), periodFrames * stretch, window));
+        }
+        float score = periodic * priorWeight(candidate, prior);
+        candidates[count++] = {candidate, score};
+    }
+    std::stable_sort(candidates.begin(), candidates.begin() + count,
+                     [](const TempoCandidate& a, const TempoCandidate& b) { return a.score > b.score; });
+    // Nothing periodic at all: keep the estimate.
+    if (candidates[0].score <= 0.0f) {
+        candidates = {};
+        candidates[0] = {bpm, 1.0f};
+        return bpm;
+    }
+    float top = candidates[0].score;
+    for (size_t i = 0; i < count; ++i) candidates[i].score /= top;
+    return candidates[0].bpm;
+}
+
+// Refines `bpm` on a 0.01 BPM grid within 1.5% of it: each grid tempo scores
+// the power of the Hann-windowed onset envelope at its first few harmonics
+// (goertzelPower()), and the best score is interpolated between grid points.
+// A zero-padded FFT would need ~6000 * framesPerSecond points for the same
+// resolution. The grid is cut off at [minBpm, maxBpm], and `bpm` is first
+// clamped to it, so refinement never leaves the range the tempo was chosen
+// in. When the best score is on the edge of the grid, i.e. the peak lies
+// outside it, returns the grid edge if the range cut the grid there and the
+// clamped `bpm` otherwise.
+inline float refineTempo(const std::vector<float>& onset, float framesPerSecond, float bpm, float minBpm,
+                         float maxBpm, std::vector<float>& scratch) {
+    TraceScope trace("refine tempo");
+    const float stepBpm = 0.01f, span = 0.015f;
+    const double pi = 3.14159265358979323846;
+    size_t n = onset.size();
+    if (bpm <= 0.0f) return bpm;
+    bpm = std::clamp(bpm, minBpm, maxBpm);
+    if (n < 4.0f * 60.0f * framesPerSecond / bpm) return bpm;
+
+    // Grid points below and above `bpm`. Harmonics up to the fourth, as long
+    // as they stay below Nyquist.
+    size_t half = static_cast<size_t>(std::ceil(bpm * span / stepBpm));
+    size_t below = std::min(half, static_cast<size_t>((bpm - minBpm) / stepBpm));
+    size_t above = std::min(half, static_cast<size_t>((maxBpm - bpm) / stepBpm));
+    size_t points = below + above + 1;
+    float topBpm = bpm + above * stepBpm;
+    size_t harmonics = std::clamp<size_t>(static_cast<size_t>(30.0f * framesPerSecond / topBpm), 1, 4);
+    size_t frequencies = points * harmonics;
+    scratch.resize(n + 2 * frequencies + points);
+    float* windowed = scratch.data();
+    float* omegas = windowed + n;
+    float* power = omegas + frequencies;
+    float* score = power + frequencies;
+
+    double mean = 0.0;
+    for (float v : onset) mean += v;
+    mean /= n;
+    for (size_t i = 0; i < n; ++i) {
+        float hann = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * pi * i / (n - 1)));
+        windowed[i] = (onset[i] - static_cast<float>(mean)) * hann;
+    }
+    for (size_t p = 0; p < points; ++p) {
+        double candidate = bpm + (double(p) - double(below)) * stepBpm;
+        for (size_t h = 0; h < harmonics; ++h) {
+            omegas[p * harmonics + h] = static_cast<float>(2.0 * pi * (h + 1) * candidate / 60.0 / framesPerSecond);
+        }
+    }
+    goertzelPower(windowed, n, omegas, frequencies, power);
+
+    size_t best = 0;
+    for (size_t p = 0; p < points; ++p) {
+        score[p] = 0.0f;
+        for (size_t h = 0; h < harmonics; ++h) score[p] += power[p * harmonics + h];
+        if (score[p] > score[best]) best = p;
+    }
+    // A peak at a range limit lies on or beyond it: that limit is the closest
+    // tempo the range allows.
+    if (best == 0) return below < half ? bpm - below * stepBpm : bpm;
+    if (best + 1 == points) return above < half ? topBpm : bpm;
+    float offset = parabolicOffset(score[best - 1], score[best], score[best + 1]);
+    return bpm + (static_cast<float>(best) - static_cast<float>(below) + offset) * stepBpm;
+}
+
+} // namespace pipeline_detail
+
+template <AnalysisPreset P>
+struct Pipeline;
+
+template <>
+struct Pipeline<AnalysisPreset::Legacy> {
+    static void run(const AnalyzerConfig& config, AnalyzerState& state, AnalysisResult& result) {
+        computeEnvelope(state.samples, config.smoothingFactor, state.envelope);
+        pipeline_detail::stageBoundary(state);
+        detectPeaks(state.envelope, config.threshold, config.minGap, state.peaks, state.positions);
+        finish(config, state, result);
+    }
+
+    // run() one tile of config.tileFrames at a time (see PeakStream), with a
+    // stage boundary after every tile, as after every decoded block.
+    static void runTiled(const AnalyzerConfig& config, AnalyzerState& state, AnalysisResult& result) {
+        TraceScope trace("tiles");
+        PeakStream stream(config.smoothingFactor, config.threshold, config.minGap, state.envelope, state.peaks,
+                          state.positions);
+        const std::vector<float>& samples = state.samples;
+        for (size_t at = 0; at < samples.size(); at += config.tileFrames) {
+            stream.push(samples.data() + at, std::min(config.tileFrames, samples.size() - at));
+            pipeline_detail::stageBoundary(state);
+        }
+        finish(config, state, result);
+    }
+
+    // Fills the result from state.peaks and state.positions.
+    static void finish(const AnalyzerConfig& config, const AnalyzerState& state, AnalysisResult& result) {
+        result.peakCount = state.peaks.size();
+        result.bpm = calculateBpm(state.positions, result.sampleRate) / config.bpmDivisor;
+        if (!state.positions.empty()) result.firstBeatSeconds = state.positions[0] / result.sampleRate;
+    }
+};
+
+template <>
+struct Pipeline<AnalysisPreset::Fast> {
+    static void run(const AnalyzerConfig& config, AnalyzerState& state, AnalysisResult& result) {
+        onset(config, state, result);
+        pipeline_detail::stageBoundary(state);
+        tempo(config, state, result);
+    }
+
+    static void onset(const AnalyzerConfig& config, AnalyzerState& state, const AnalysisResult&) {
+        pipeline_detail::decimatedEnvelope(state.samples, config.hopSize, state.onset);
+        pipeline_detail::positiveDifference(state.onset);
+    }
+
+    static void tempo(const AnalyzerConfig& config, AnalyzerState& state, AnalysisResult& result) {
+        const float framesPerSecond = static_cast<float>(result.sampleRate) / config.hopSize;
+        TraceScope trace("tempo", MetricStage::Tempo);
+        float estimate = pipeline_detail::histogramTempo(state.onset, framesPerSecond, config.minBpm, config.maxBpm,
+                                                         config.tempoPrior, state.hopIndices, state.positions,
+                                                         state.scratch);
+        float resolved = pipeline_detail::resolveTempo(state.onset, framesPerSecond, estimate, config.minBpm,
+                                                       config.maxBpm, config.tempoPrior, result.tempoCandidates);
+        result.bpm = pipeline_detail::refineTempo(state.onset, framesPerSecond, resolved, config.minBpm,
+                                                  config.maxBpm, state.scratch);
+        result.peakCount = state.hopIndices.size();
+        if (!state.positions.empty()) result.firstBeatSeconds = state.positions[0] / framesPerSecond;
+    }
+};
+
+template <>
+struct Pipeline<AnalysisPreset::Balanced> {
+    static void run(const AnalyzerConfig& config, AnalyzerState& state, AnalysisResult& result) {
+        onset(config, state, result);
+        pipeline_detail::stageBoundary(state);
+        tempo(config, state, result);
+    }
+
+    static void onset(const AnalyzerConfig& config, AnalyzerState& state, const AnalysisResult&) {
+        pipeline_detail::logEnergyFlux(state.samples, config.hopSize, state.onset);
+    }
+
+    static void tempo(const AnalyzerConfig& config, AnalyzerState& state, AnalysisResult& result) {
+        const float framesPerSecond = static_cast<float>(result.sampleRate) / config.hopSize;
+        TraceScope trace("tempo", MetricStage::Tempo);
+        float estimate = pipeline_detail::coarseToFineTempo(state.onset, framesPerSecond, config.minBpm,
+                                                            config.maxBpm, config.tempoPrior, state.scratch);
+        float resolved = pipeline_detail::resolveTempo(state.onset, framesPerSecond, estimate, config.minBpm,
+                                                       config.maxBpm, config.tempoPrior, result.tempoCandidates);
+        result.bpm = pipeline_detail::refineTempo(state.onset, framesPerSecond, resolved, config.minBpm,
+                                                  config.maxBpm, state.scratch);
+        state.hopIndices.clear();
+        state.positions.clear();
+        result.peakCount = 0;
+        if (result.bpm > 0.0f) {
+            float periodFrames = 60.0f * framesPerSecond / result.bpm;
+            result.firstBeatSeconds = pipeline_detail::beatPhase(state.onset, periodFrames) / framesPerSecond;
+        }
+    }
+};
+
+template <>
+struct Pipeline<AnalysisPreset::Accurate> {
+    static void run(const AnalyzerConfig& config, AnalyzerState& state, AnalysisResult& result) {
+        onset(config, state, result);
+        pipeline_detail::stageBoundary(state);
+        tempo(config, state, result);
+    }
+
+    static void onset(const AnalyzerConfig& config, AnalyzerState& state, const AnalysisResult& result) {
+        pipeline_detail::multibandFlux(state.samples, result.sampleRate, config.hopSize, state.envelope, state.onset);
+    }
+
+    static void tempo(const AnalyzerConfig& config, AnalyzerState& state, AnalysisResult& result) {
+        const float framesPerSecond = static_cast<float>(result.sampleRate) / config.hopSize;
+        TraceScope trace("tempo", MetricStage::Tempo);
+        float estimate = pipeline_detail::coarseToFineTempo(state.onset, framesPerSecond, config.minBpm,
+                                                            config.maxBpm, config.tempoPrior, state.scratch);
+        float coarse = pipeline_detail::resolveTempo(state.onset, framesPerSecond, estimate, config.minBpm,
+                                                     config.maxBpm, config.tempoPrior, result.tempoCandidates);
+        float tracked = pipeline_detail::trackBeats(state.onset, framesPerSecond, coarse, state.scratch,
+                                                    state.hopIndices, state.positions);
+        result.bpm = pipeline_detail::refineTempo(state.onset, framesPerSecond, tracked, config.minBpm,
+                                                  config.maxBpm, state.scratch);
+        result.peakCount = state.hopIndices.size();
+        if (!state.positions.empty()) result.firstBeatSeconds = state.positions[0] / framesPerSecond;
+    }
+};
@@ -0,0 +1,56 @@
+// Runs the onset-based presets over synthetic audio with tempo ranges that
+// are not a whole number of BPM, or that end just below the track's tempo,
+// and checks that each finds a tempo inside the range. Exits non-zero if any
+// case fails; run with `make test`.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "analyzer.h"
+#include "synth.h"
+
+namespace {
+
+bool expectInRange(const std::string& label, AnalysisPreset preset, float trackBpm, float minBpm, float maxBpm) {
+    SynthTrack track;
+    track.bpm = trackBpm;
+    track.seconds = 20.0;
+    track.channels = 1;
+    AnalyzerState state;
+    synthesizeTrack(track, state.samples);
+
+    AnalyzerConfig config;
+    config.preset = preset;
+    config.minBpm = minBpm;
+    config.maxBpm = maxBpm;
+    Analyzer analyzer(config);
+    AnalysisResult result;
+    result.sampleRate = track.sampleRate;
+    result.channels = track.channels;
+    result.frames = static_cast<sf_count_t>(state.samples.size());
+    result.ok = true;
+    analyzer.analyzeDecoded(state, result);
+
+    if (result.bpm < minBpm || result.bpm > maxBpm) {
+        std::cerr << "FAIL " << label << ": " << result.bpm << " BPM outside " << minBpm << "-" << maxBpm
+                  << std::endl;
+        return false;
+    }
+    std::cout << "ok   " << label << ": " << result.bpm << " BPM" << std::endl;
+    return true;
+}
+
+} // namespace
+
+int main() {
+    bool passed = true;
+    passed &= expectInRange("fast 60.5-200 at 200 BPM", AnalysisPreset::Fast, 200.0f, 60.5f, 200.0f);
+    passed &= expectInRange("fast 60-70.5 at 70 BPM", AnalysisPreset::Fast, 70.0f, 60.0f, 70.5f);
+    passed &= expectInRange("fast 60.5-69.5 at 138 BPM", AnalysisPreset::Fast, 138.0f, 60.5f, 69.5f);
+    passed &= expectInRange("balanced 60.5-200 at 200 BPM", AnalysisPreset::Balanced, 200.0f, 60.5f, 200.0f);
+    passed &= expectInRange("fast 60-200 at 200.6 BPM", AnalysisPreset::Fast, 200.6f, 60.0f, 200.0f);
+    passed &= expectInRange("balanced 60-200 at 200.6 BPM", AnalysisPreset::Balanced, 200.6f, 60.0f, 200.0f);
+    passed &= expectInRange("accurate 60-200 at 200.6 BPM", AnalysisPreset::Accurate, 200.6f, 60.0f, 200.0f);
+    return passed ? 0 : 1;
+}
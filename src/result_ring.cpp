@@ -0,0 +1,313 @@
+#include "result_ring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+namespace {
+
+constexpr uint32_t ringMagic = 0x42504d52;  // "BPMR"
+constexpr uint32_t ringVersion = 1;
+
+size_t ringBytes(uint32_t capacity) {
+    return sizeof(ResultRingHeader) + size_t(capacity) * sizeof(ResultRecord);
+}
+
+void copyTruncated(char* destination, size_t size, const std::string& text) {
+    size_t length = std::min(size - 1, text.size());
+    std::memcpy(destination, text.data(), length);
+    destination[length] = '\0';
+}
+
+// Drains the notification descriptor so the next wait() blocks again.
+void drainNotify(int fd) {
+    char buffer[64];
+    while (::read(fd, buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+} // namespace
+
+ResultRingWriter::~ResultRingWriter() {
+    if (header_) {
+        ::munmap(header_, mappedSize_);
+        // Another daemon may have replaced the name since; leave its ring be.
+        int fd = ::shm_open(name_.c_str(), O_RDONLY, 0);
+        if (fd >= 0) {
+            struct stat info;
+            if (::fstat(fd, &info) == 0 && info.st_dev == device_ && info.st_ino == inode_) {
+                ::shm_unlink(name_.c_str());
+            }
+            ::close(fd);
+        }
+    }
+    if (notifyWriteFd_ >= 0 && notifyWriteFd_ != notifyReadFd_) ::close(notifyWriteFd_);
+    if (notifyReadFd_ >= 0) ::close(notifyReadFd_);
+}
+
+bool ResultRingWriter::create(const std::string& name, uint32_t capacity, std::string& error) {
+    if (capacity == 0) {
+        error = "Ring capacity must be positive";
+        return false;
+    }
+    // Truncating an existing object would SIGBUS readers that still map it,
+    // e.g. a UI attached to a previous daemon. Unlinking first gives this ring
+    // a fresh object and leaves theirs mapped until they let go of it.
+    if (::shm_unlink(name.c_str()) != 0 && errno != ENOENT) {
+        error = std::string("shm_unlink: ") + std::strerror(errno);
+        return false;
+    }
+    int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        error = std::string("shm_open: ") + std::strerror(errno);
+        return false;
+    }
+    size_t bytes = ringBytes(capacity);
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        error = std::string("fstat: ") + std::strerror(errno);
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        return false;
+    }
+    if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        error = std::string("ftruncate: ") + std::strerror(errno);
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        return false;
+    }
+    void* mapping = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        error = std::string("mmap: ") + std::strerror(errno);
+        ::shm_unlink(name.c_str());
+        return false;
+    }
+
+#ifdef __linux__
+    notifyReadFd_ = notifyWriteFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (notifyReadFd_ < 0) {
+#else
+    int pipeFds[2];
+    if (::pipe(pipeFds) == 0) {
+        notifyReadFd_ = pipeFds[0];
+        notifyWriteFd_ = pipeFds[1];
+        ::fcntl(notifyReadFd_, F_SETFL, O_NONBLOCK);
+        ::fcntl(notifyWriteFd_, F_SETFL, O_NONBLOCK);
+    } else {
+#endif
+        error = std::string("notification descriptor: ") + std::strerror(errno);
+        ::munmap(mapping, bytes);
+        ::shm_unlink(name.c_str());
+        return false;
+    }
+
+    name_ = name;
+    device_ = info.st_dev;
+    inode_ = info.st_ino;
+    mappedSize_ = bytes;
+    header_ = new (mapping) ResultRingHeader();
+    header_->magic = ringMagic;
+    header_->version = ringVersion;
+    header_->recordSize = sizeof(ResultRecord);
+    header_->capacity = capacity;
+    capacity_ = capacity;
+    records_ = reinterpret_cast<ResultRecord*>(static_cast<char*>(mapping) + sizeof(ResultRingHeader));
+    return true;
+}
+
+void ResultRingWriter::publish(const AnalysisResult& result) {
+    if (!header_) return;
+    {
+        std::lock_guard<std::mutex> guard(publishMutex_);
+        uint64_t write = header_->writeIndex.load(std::memory_order_relaxed);
+        uint64_t read = header_->readIndex.load(std::memory_order_acquire);
+        if (write - read >= capacity_) {
+            header_->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        ResultRecord& record = records_[write % capacity_];
+        record.sequence = write;
+        record.ok = result.ok ? 1 : 0;
+        record.sampleRate = static_cast<uint32_t>(result.sampleRate);
+        record.channels = static_cast<uint32_t>(result.channels);
+        record.peakCount = static_cast<uint32_t>(result.peakCount);
+        record.frames = result.frames;
+        record.bpm = result.bpm;
+        record.reserved = 0.0f;
+        record.firstBeatSeconds = result.firstBeatSeconds;
+        record.beatPeriodSeconds = result.beatPeriodSeconds;
+        copyTruncated(record.source, sizeof(record.source), result.source);
+        copyTruncated(record.error, sizeof(record.error), result.error);
+        std::memcpy(record.overview, result.overview.data(), sizeof(record.overview));
+
+        header_->writeIndex.store(write + 1, std::memory_order_release);
+    }
+
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t ignored = ::write(notifyWriteFd_, &one, sizeof(one));
+#else
+    char one = 1;
+    ssize_t ignored = ::write(notifyWriteFd_, &one, 1);
+#endif
+    (void)ignored;
+}
+
+ResultRingReader::~ResultRingReader() {
+    if (header_) ::munmap(header_, mappedSize_);
+    if (notifyFd_ >= 0) ::close(notifyFd_);
+    if (socketFd_ >= 0) ::close(socketFd_);
+}
+
+bool ResultRingReader::open(const std::string& name, int notifyFd, std::string& error) {
+    notifyFd_ = notifyFd;
+    int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        error = std::string("shm_open: ") + std::strerror(errno);
+        return false;
+    }
+    // Mapping past the end of the object would SIGBUS on first access, so
+    // the header and then the capacity it claims are checked against its size.
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        error = std::string("fstat: ") + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (static_cast<uint64_t>(info.st_size) < sizeof(ResultRingHeader)) {
+        error = "Ring smaller than its header";
+        ::close(fd);
+        return false;
+    }
+    // Map the header first to learn the capacity, then the whole ring.
+    void* mapping = ::mmap(nullptr, sizeof(ResultRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        error = std::string("mmap: ") + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    auto* header = static_cast<const ResultRingHeader*>(mapping);
+    bool valid = header->magic == ringMagic && header->version == ringVersion &&
+                 header->recordSize == sizeof(ResultRecord);
+    uint32_t capacity = header->capacity;
+    ::munmap(mapping, sizeof(ResultRingHeader));
+    if (!valid) {
+        error = "Ring layout mismatch";
+        ::close(fd);
+        return false;
+    }
+    if (capacity == 0 || ringBytes(capacity) > static_cast<uint64_t>(info.st_size)) {
+        error = "Ring capacity does not match its size";
+        ::close(fd);
+        return false;
+    }
+
+    mappedSize_ = ringBytes(capacity);
+    mapping = ::mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        error = std::string("mmap: ") + std::strerror(errno);
+        return false;
+    }
+    header_ = static_cast<ResultRingHeader*>(mapping);
+    capacity_ = capacity;
+    records_ = reinterpret_cast<const ResultRecord*>(static_cast<char*>(mapping) + sizeof(ResultRingHeader));
+    return true;
+}
+
+bool ResultRingReader::connect(const std::string& socketPath, std::string& error) {
+    socketFd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    if (socketFd_ < 0 || ::connect(socketFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        error = std::string("connect: ") + std::strerror(errno);
+        return false;
+    }
+
+    const char request[] = "subscribe\t0\tsubscribe\t-\n";
+    if (::send(socketFd_, request, sizeof(request) - 1, MSG_NOSIGNAL) < 0) {
+        error = std::string("send: ") + std::strerror(errno);
+        return false;
+    }
+
+    // Reply: "subscribe TAB ok TAB <ring name> LF" with the descriptor attached.
+    std::string reply;
+    int receivedFd = -1;
+    while (reply.find('\n') == std::string::npos) {
+        char buffer[512];
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        iovec io{buffer, sizeof(buffer)};
+        msghdr message = {};
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t got = ::recvmsg(socketFd_, &message, 0);
+        if (got <= 0) {
+            error = "Daemon closed the connection";
+            return false;
+        }
+        for (cmsghdr* c = CMSG_FIRSTHDR(&message); c; c = CMSG_NXTHDR(&message, c)) {
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+                std::memcpy(&receivedFd, CMSG_DATA(c), sizeof(int));
+            }
+        }
+        reply.append(buffer, static_cast<size_t>(got));
+    }
+    reply.erase(reply.find('\n'));
+
+    const std::string prefix = "subscribe\tok\t";
+    if (reply.compare(0, prefix.size(), prefix) != 0 || receivedFd < 0) {
+        if (receivedFd >= 0) ::close(receivedFd);
+        error = "Subscription refused: " + reply;
+        return false;
+    }
+    return open(reply.substr(prefix.size()), receivedFd, error);
+}
+
+const ResultRecord* ResultRingReader::front() const {
+    uint64_t read = header_->readIndex.load(std::memory_order_relaxed);
+    if (read == header_->writeIndex.load(std::memory_order_acquire)) return nullptr;
+    return &records_[read % capacity_];
+}
+
+void ResultRingReader::pop() {
+    header_->readIndex.fetch_add(1, std::memory_order_release);
+}
+
+bool ResultRingReader::wait(int timeoutMs) {
+    // A wakeup can belong to records already consumed, so keep polling until
+    // something is actually there or the timeout runs out.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!front()) {
+        int remaining = -1;
+        if (timeoutMs >= 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) return false;
+            remaining = static_cast<int>(left.count());
+        }
+        pollfd pending{notifyFd_, POLLIN, 0};
+        if (::poll(&pending, 1, remaining) > 0) drainNotify(notifyFd_);
+    }
+    return true;
+}
+
+uint64_t ResultRingReader::dropped() const {
+    return header_->dropped.load(std::memory_order_relaxed);
+}
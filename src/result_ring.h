@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <type_traits>
+
+#include <sys/types.h>
+
+#include "analyzer.h"
+
+// Fixed-size result record as laid out in the shared-memory ring. Plain data
+// only, so the reader uses records in place.
+struct alignas(64) ResultRecord {
+    uint64_t sequence;
+    uint32_t ok;
+    uint32_t sampleRate;
+    uint32_t channels;
+    uint32_t peakCount;
+    int64_t frames;
+    float bpm;
+    float reserved;
+    double firstBeatSeconds;
+    double beatPeriodSeconds;
+    char source[448];                       // NUL-terminated, truncated if longer
+    char error[64];                         // NUL-terminated, empty when ok
+    uint8_t overview[overviewTileCount];
+};
+static_assert(std::is_trivially_copyable_v<ResultRecord>, "records are shared across processes");
+
+// Shared-memory header. Indices count records ever written/consumed; slot for
+// index i is i % capacity.
+struct ResultRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t capacity;
+    alignas(64) std::atomic<uint64_t> writeIndex;
+    alignas(64) std::atomic<uint64_t> readIndex;
+    alignas(64) std::atomic<uint64_t> dropped;  // results discarded because the ring was full
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring indices must be lock-free across processes");
+
+// Producer side, owned by the analysis process. publish() may be called from
+// any worker; the single consumer is notified through notifyFd().
+class ResultRingWriter {
+public:
+    ResultRingWriter() = default;
+    ~ResultRingWriter();
+    ResultRingWriter(const ResultRingWriter&) = delete;
+    ResultRingWriter& operator=(const ResultRingWriter&) = delete;
+
+    // Creates POSIX shared memory object `name` (e.g. "/bpm-results") holding
+    // `capacity` records. An existing object of that name is unlinked, not
+    // reused, so readers still mapping it are unaffected. Returns false and
+    // fills `error` on failure.
+    bool create(const std::string& name, uint32_t capacity, std::string& error);
+
+    // Copies `result` into the next free slot. Drops it (and counts the drop)
+    // if the reader has fallen a full ring behind.
+    void publish(const AnalysisResult& result);
+
+    const std::string& name() const { return name_; }
+    // eventfd (Linux) or pipe read end that becomes readable after publish().
+    int notifyFd() const { return notifyReadFd_; }
+
+private:
+    std::string name_;
+    dev_t device_ = 0;  // identity of the object created, so the destructor
+    ino_t inode_ = 0;   // only unlinks `name_` if it still refers to it
+    ResultRingHeader* header_ = nullptr;
+    ResultRecord* records_ = nullptr;
+    uint32_t capacity_ = 0;  // private copy; readers map the header writable
+    size_t mappedSize_ = 0;
+    int notifyReadFd_ = -1;
+    int notifyWriteFd_ = -1;
+    std::mutex publishMutex_;
+};
+
+// Consumer side, used by the UI process. Records are read in place: front()
+// points into shared memory and stays valid until pop().
+class ResultRingReader {
+public:
+    ResultRingReader() = default;
+    ~ResultRingReader();
+    ResultRingReader(const ResultRingReader&) = delete;
+    ResultRingReader& operator=(const ResultRingReader&) = delete;
+
+    // Maps ring `name` and takes ownership of `notifyFd` (as received from the
+    // daemon's subscribe request).
+    bool open(const std::string& name, int notifyFd, std::string& error);
+
+    // Subscribes through the analysis daemon's socket, receiving the ring name
+    // and notification descriptor, then maps the ring.
+    bool connect(const std::string& socketPath, std::string& error);
+
+    const ResultRecord* front() const;
+    void pop();
+
+    // Blocks up to `timeoutMs` (-1 = forever) for new records. Returns true if
+    // at least one record is available.
+    bool wait(int timeoutMs);
+
+    uint64_t dropped() const;
+    int notifyFd() const { return notifyFd_; }
+
+private:
+    ResultRingHeader* header_ = nullptr;
+    const ResultRecord* records_ = nullptr;
+    uint32_t capacity_ = 0;  // validated at open(); the writer could change the shared copy
+    size_t mappedSize_ = 0;
+    int notifyFd_ = -1;
+    int socketFd_ = -1;
+};
@@ -0,0 +1,140 @@
+#include "scheduler.h"
+
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+AnalysisScheduler::AnalysisScheduler(unsigned threads, float backgroundShare)
+    : threadCount_(std::max(1u, threads)), backgroundShare_(std::clamp(backgroundShare, 0.0f, 1.0f)) {
+    for (unsigned t = 0; t < threadCount_; ++t) {
+        workers_.emplace_back([this, t] {
+            setTraceThreadName("worker " + std::to_string(t));
+            workerLoop();
+        });
+    }
+}
+
+AnalysisScheduler::~AnalysisScheduler() {
+    shutdown();
+}
+
+void AnalysisScheduler::submit(JobClass jobClass, Task task) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (jobClass == JobClass::Interactive) {
+        interactive_.push_back(std::move(task));
+        interactivePending_.fetch_add(1, std::memory_order_release);
+    } else {
+        background_.push_back(std::move(task));
+    }
+    wake_.notify_all();
+}
+
+void AnalysisScheduler::setPlaybackActive(bool active) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    playbackActive_.store(active, std::memory_order_relaxed);
+    updateOverLimit();
+    wake_.notify_all();
+}
+
+size_t AnalysisScheduler::pending(JobClass jobClass) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return jobClass == JobClass::Interactive ? interactive_.size() : background_.size();
+}
+
+void AnalysisScheduler::shutdown() {
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (closed_ && workers_.empty()) return;
+        closed_ = true;
+        wake_.notify_all();
+    }
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+}
+
+// At least one worker always stays available for background work so a
+// library scan still makes progress during playback.
+unsigned AnalysisScheduler::backgroundLimit() const {
+    if (!playbackActive_.load(std::memory_order_relaxed)) return threadCount_;
+    return std::max(1u, static_cast<unsigned>(std::floor(threadCount_ * backgroundShare_)));
+}
+
+// Call with mutex_ held whenever activeBackground_ or the limit changes.
+void AnalysisScheduler::updateOverLimit() {
+    overLimit_.store(activeBackground_ > backgroundLimit(), std::memory_order_relaxed);
+}
+
+// Runs queued interactive jobs with the lock released between them.
+void AnalysisScheduler::runInteractive(std::unique_lock<std::mutex>& lock, AnalyzerState& state) {
+    while (!interactive_.empty()) {
+        Task task = std::move(interactive_.front());
+        interactive_.pop_front();
+        interactivePending_.fetch_sub(1, std::memory_order_relaxed);
+        lock.unlock();
+        task(state);
+        lock.lock();
+    }
+}
+
+// Installed as the background state's blockHook. The common case, also
+// during playback, is two atomic loads; the lock is only taken when an
+// interactive job is pending or this job has to park.
+void AnalysisScheduler::preemptionPoint(AnalyzerState& interactiveState) {
+    if (interactivePending_.load(std::memory_order_acquire) == 0 && !overLimit_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        runInteractive(lock, interactiveState);
+        if (activeBackground_ <= backgroundLimit() || closed_) return;
+
+        // Over the background share: park until a slot frees up, serving any
+        // interactive work that arrives meanwhile.
+        --activeBackground_;
+        ++parkedBackground_;
+        updateOverLimit();
+        wake_.wait(lock, [this] {
+            return closed_ || !interactive_.empty() || activeBackground_ < backgroundLimit();
+        });
+        --parkedBackground_;
+        ++activeBackground_;
+        updateOverLimit();
+    }
+}
+
+void AnalysisScheduler::workerLoop() {
+    AnalyzerState interactiveState;
+    AnalyzerState backgroundState;
+    backgroundState.blockHook = [this, &interactiveState] { preemptionPoint(interactiveState); };
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] {
+            // Parked jobs get freed slots before new background jobs start.
+            bool backgroundReady = !background_.empty() && parkedBackground_ == 0 &&
+                                   activeBackground_ < backgroundLimit();
+            return !interactive_.empty() || backgroundReady || (closed_ && background_.empty());
+        });
+
+        if (!interactive_.empty()) {
+            runInteractive(lock, interactiveState);
+            continue;
+        }
+        if (background_.empty()) return;  // closed and drained
+
+        Task task = std::move(background_.front());
+        background_.pop_front();
+        ++activeBackground_;
+        updateOverLimit();
+        lock.unlock();
+        task(backgroundState);
+        lock.lock();
+        --activeBackground_;
+        updateOverLimit();
+        wake_.notify_all();
+    }
+}
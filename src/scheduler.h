@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "analyzer.h"
+
+enum class JobClass { Interactive, Background };
+
+// Worker pool with two priority classes. Interactive jobs always run first;
+// a background job in progress checks for them at every decode block and
+// analysis stage boundary (AnalyzerState::blockHook) and runs them on its own
+// thread before resuming,
+// so interactive latency does not depend on how much background work is
+// queued. While playback is active, background work is limited to a share of
+// the workers; jobs over the limit park at their next block boundary.
+class AnalysisScheduler {
+public:
+    // Tasks receive the worker's AnalyzerState for the job's class.
+    using Task = std::function<void(AnalyzerState&)>;
+
+    AnalysisScheduler(unsigned threads, float backgroundShare);
+    ~AnalysisScheduler();
+
+    void submit(JobClass jobClass, Task task);
+    void setPlaybackActive(bool active);
+    size_t pending(JobClass jobClass);
+
+    // Runs everything already queued, then stops the workers. Idempotent.
+    void shutdown();
+
+private:
+    void workerLoop();
+    void preemptionPoint(AnalyzerState& interactiveState);
+    void runInteractive(std::unique_lock<std::mutex>& lock, AnalyzerState& state);
+    unsigned backgroundLimit() const;
+    void updateOverLimit();
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Task> interactive_;
+    std::deque<Task> background_;
+    std::atomic<size_t> interactivePending_{0};
+    unsigned activeBackground_ = 0;
+    unsigned parkedBackground_ = 0;
+    unsigned threadCount_;
+    float backgroundShare_;
+    std::atomic<bool> playbackActive_{false};
+    std::atomic<bool> overLimit_{false};  // activeBackground_ > backgroundLimit(); written under mutex_
+    bool closed_ = false;
+    std::vector<std::thread> workers_;
+};
@@ -0,0 +1,440 @@
+#include "server.h"
+
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "result_ring.h"
+#include "trace.h"
+#include "scheduler.h"
+
+extern std::mutex outputMutex;
+
+namespace {
+
+std::atomic<bool> stopRequested{false};
+
+void handleStopSignal(int) {
+    stopRequested = true;
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Replies are written from worker threads. A client that stops reading them
+// gets this long to drain its socket before it is disconnected, so it cannot
+// pin a worker or hold up shutdown.
+constexpr timeval sendTimeout{5, 0};
+
+// One client socket. Workers and the reader thread share it through a
+// shared_ptr, so the descriptor closes once the last pending reply is sent.
+// A failed or timed-out write shuts the socket down: the reader thread sees
+// end of stream and later replies are dropped.
+class Connection {
+public:
+    explicit Connection(int fd) : fd_(fd) {
+        ::setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+    }
+    ~Connection() { ::close(fd_); }
+
+    int fd() const { return fd_; }
+
+    void send(const std::string& line) {
+        std::lock_guard<std::mutex> guard(writeMutex_);
+        if (broken_) return;
+        if (!writeAll(fd_, line.data(), line.size())) drop();
+    }
+
+    // Sends `line` with `descriptor` attached as SCM_RIGHTS ancillary data.
+    void sendWithDescriptor(const std::string& line, int descriptor) {
+        std::lock_guard<std::mutex> guard(writeMutex_);
+        if (broken_) return;
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+        iovec io{const_cast<char*>(line.data()), line.size()};
+        msghdr message = {};
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(header), &descriptor, sizeof(int));
+        ssize_t sent;
+        do {
+            sent = ::sendmsg(fd_, &message, MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+        if (sent < 0 || !writeAll(fd_, line.data() + sent, line.size() - static_cast<size_t>(sent))) {
+            drop();
+        }
+    }
+
+private:
+    void drop() {
+        broken_ = true;
+        ::shutdown(fd_, SHUT_RDWR);
+    }
+
+    int fd_;
+    std::mutex writeMutex_;
+    bool broken_ = false;  // guarded by writeMutex_
+};
+
+// Buffered reader for the line-oriented request stream.
+class RequestReader {
+public:
+    explicit RequestReader(int fd) : fd_(fd) {}
+
+    bool readLine(std::string& line) {
+        for (;;) {
+            size_t newline = pending_.find('\n', start_);
+            if (newline != std::string::npos) {
+                line.assign(pending_, start_, newline - start_);
+                start_ = newline + 1;
+                return true;
+            }
+            if (!fill()) return false;
+        }
+    }
+
+    bool readBytes(std::vector<unsigned char>& bytes, size_t count) {
+        while (pending_.size() - start_ < count) {
+            if (!fill()) return false;
+        }
+        bytes.assign(pending_.begin() + start_, pending_.begin() + start_ + count);
+        start_ += count;
+        return true;
+    }
+
+private:
+    bool fill() {
+        if (start_ > 0) {
+            pending_.erase(0, start_);
+            start_ = 0;
+        }
+        char chunk[65536];
+        for (;;) {
+            ssize_t got = ::recv(fd_, chunk, sizeof(chunk), 0);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+            pending_.append(chunk, static_cast<size_t>(got));
+            return true;
+        }
+    }
+
+    int fd_;
+    std::string pending_;
+    size_t start_ = 0;
+};
+
+struct Job {
+    std::shared_ptr<Connection> connection;
+    std::string id;
+    std::string path;                   // empty for buffer requests
+    std::vector<unsigned char> buffer;
+    std::string label;
+};
+
+// Results keyed by path and invalidated when the file's size or mtime changes.
+class ResultCache {
+public:
+    explicit ResultCache(size_t capacity) : capacity_(capacity) {}
+
+    bool lookup(const std::string& path, AnalysisResult& result) {
+        struct stat info;
+        if (::stat(path.c_str(), &info) != 0) return false;
+        std::lock_guard<std::mutex> guard(mutex_);
+        auto it = entries_.find(path);
+        if (it == entries_.end() || it->second.size != info.st_size ||
+            it->second.mtime != info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec) {
+            return false;
+        }
+        result = it->second.result;
+        return true;
+    }
+
+    void store(const std::string& path, const AnalysisResult& result) {
+        struct stat info;
+        if (!result.ok || ::stat(path.c_str(), &info) != 0) return;
+        std::lock_guard<std::mutex> guard(mutex_);
+        // Crude but bounded: start over rather than track recency.
+        if (entries_.size() >= capacity_) entries_.clear();
+        entries_[path] = {info.st_size, info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec, result};
+    }
+
+private:
+    struct Entry {
+        off_t size;
+        long long mtime;
+        AnalysisResult result;
+    };
+
+    size_t capacity_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+std::string formatResponse(const std::string& id, const AnalysisResult& result) {
+    std::ostringstream out;
+    if (result.ok) {
+        out << id << "\tok\t" << result.bpm << '\t' << result.sampleRate << '\t' << result.channels << '\t'
+            << result.frames << '\t' << result.peakCount << '\n';
+    } else {
+        out << id << "\terror\t" << result.error << '\n';
+    }
+    return out.str();
+}
+
+std::string formatError(const std::string& id, const std::string& message) {
+    return id + "\terror\t" + message + "\n";
+}
+
+std::vector<std::string> splitTabs(const std::string& line, size_t maxFields) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (fields.size() + 1 < maxFields) {
+        size_t tab = line.find('\t', start);
+        if (tab == std::string::npos) break;
+        fields.push_back(line.substr(start, tab - start));
+        start = tab + 1;
+    }
+    fields.push_back(line.substr(start));
+    return fields;
+}
+
+class Server {
+public:
+    explicit Server(const ServerOptions& options)
+        : options_(options), analyzer_(withOverview(options)), cache_(options.cacheEntries),
+          scheduler_(options.threads, options.backgroundShare) {}
+
+    int run();
+
+private:
+    static AnalyzerConfig withOverview(const ServerOptions& options) {
+        AnalyzerConfig config = options.config;
+        config.computeOverview = config.computeOverview || !options.resultRing.empty();
+        return config;
+    }
+
+    void runJob(Job& job, AnalyzerState& state);
+    void serveConnection(std::shared_ptr<Connection> connection);
+
+    const ServerOptions& options_;
+    const Analyzer analyzer_;
+    ResultCache cache_;
+    ResultRingWriter ring_;
+    AnalysisScheduler scheduler_;
+
+    std::mutex connectionsMutex_;
+    std::condition_variable connectionsDone_;
+    std::unordered_set<int> liveConnections_;
+};
+
+void Server::runJob(Job& job, AnalyzerState& state) {
+    auto start = std::chrono::steady_clock::now();
+    TraceScope trace("job", job.path.empty() ? &job.label : &job.path);
+    AnalysisResult result;
+    if (!job.path.empty()) {
+        result = analyzer_.analyzeFile(job.path, state);
+        cache_.store(job.path, result);
+    } else {
+        result = analyzer_.analyzeMemory(job.buffer.data(), job.buffer.size(), job.label, state);
+    }
+    Metrics& metrics = Metrics::instance();
+    metrics.recordResult(result);
+
+    auto outputStart = std::chrono::steady_clock::now();
+    {
+        TraceScope outputTrace("output");
+        ring_.publish(result);
+        job.connection->send(formatResponse(job.id, result));
+    }
+    auto end = std::chrono::steady_clock::now();
+    metrics.recordStage(MetricStage::Output, std::chrono::duration<double>(end - outputStart).count());
+    metrics.addBusySeconds(std::chrono::duration<double>(end - start).count());
+}
+
+void Server::serveConnection(std::shared_ptr<Connection> connection) {
+    RequestReader reader(connection->fd());
+    std::string line;
+    while (reader.readLine(line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        std::vector<std::string> fields = splitTabs(line, 5);
+        if (fields.size() < 4) {
+            connection->send(formatError(fields[0], "Malformed request"));
+            continue;
+        }
+        Job job;
+        job.connection = connection;
+        job.id = fields[0];
+        int priority = std::atoi(fields[1].c_str());
+
+        if (fields[2] == "path") {
+            job.path = fields[3];
+            AnalysisResult cached;
+            if (cache_.lookup(job.path, cached)) {
+                cached.source = job.path;
+                ring_.publish(cached);
+                connection->send(formatResponse(job.id, cached));
+                continue;
+            }
+        } else if (fields[2] == "playback") {
+            scheduler_.setPlaybackActive(fields[3] == "1");
+            connection->send(job.id + "\tok\n");
+            continue;
+        } else if (fields[2] == "subscribe") {
+            if (ring_.name().empty()) {
+                connection->send(formatError(job.id, "No result ring configured"));
+            } else {
+                connection->sendWithDescriptor(job.id + "\tok\t" + ring_.name() + "\n", ring_.notifyFd());
+            }
+            continue;
+        } else if (fields[2] == "buffer") {
+            char* end = nullptr;
+            unsigned long long size = std::strtoull(fields[3].c_str(), &end, 10);
+            if (end == fields[3].c_str() || *end != '\0') {
+                connection->send(formatError(job.id, "Malformed buffer size"));
+                continue;
+            }
+            if (size > options_.maxBufferBytes) {
+                connection->send(formatError(job.id, "Buffer too large"));
+                break;
+            }
+            job.label = fields.size() > 4 ? fields[4] : job.id;
+            if (!reader.readBytes(job.buffer, static_cast<size_t>(size))) break;
+        } else {
+            connection->send(formatError(job.id, "Unknown request type"));
+            continue;
+        }
+        auto shared = std::make_shared<Job>(std::move(job));
+        scheduler_.submit(priority > 0 ? JobClass::Interactive : JobClass::Background,
+                          [this, shared](AnalyzerState& state) { runJob(*shared, state); });
+    }
+
+    std::lock_guard<std::mutex> guard(connectionsMutex_);
+    liveConnections_.erase(connection->fd());
+    connectionsDone_.notify_all();
+}
+
+int Server::run() {
+    if (!options_.resultRing.empty()) {
+        std::string error;
+        if (!ring_.create(options_.resultRing, options_.resultRingCapacity, error)) {
+            std::cerr << "Cannot create result ring " << options_.resultRing << ": " << error << std::endl;
+            return 1;
+        }
+    }
+
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        std::cerr << "socket: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (options_.socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << options_.socketPath << std::endl;
+        ::close(listenFd);
+        return 2;
+    }
+    std::strncpy(address.sun_path, options_.socketPath.c_str(), sizeof(address.sun_path) - 1);
+    ::unlink(options_.socketPath.c_str());
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd, 64) != 0) {
+        std::cerr << "Cannot listen on " << options_.socketPath << ": " << std::strerror(errno) << std::endl;
+        ::close(listenFd);
+        return 1;
+    }
+
+    Metrics& metrics = Metrics::instance();
+    metrics.setWorkerCount(options_.threads);
+    metrics.registerGauge("bpm_queue_depth_interactive", "Interactive jobs waiting for a worker.",
+                          [this] { return double(scheduler_.pending(JobClass::Interactive)); });
+    metrics.registerGauge("bpm_queue_depth_background", "Background jobs waiting for a worker.",
+                          [this] { return double(scheduler_.pending(JobClass::Background)); });
+
+    std::signal(SIGINT, handleStopSignal);
+    std::signal(SIGTERM, handleStopSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    {
+        std::lock_guard<std::mutex> guard(outputMutex);
+        std::cerr << "Listening on " << options_.socketPath << " with " << options_.threads << " workers"
+                  << std::endl;
+    }
+
+    while (!stopRequested) {
+        pollfd pending{listenFd, POLLIN, 0};
+        if (::poll(&pending, 1, 200) <= 0) continue;
+        int clientFd = ::accept(listenFd, nullptr, nullptr);
+        if (clientFd < 0) continue;
+
+        // Each connection holds a thread, so clients past the cap are closed
+        // unread rather than left to exhaust the process.
+        {
+            std::lock_guard<std::mutex> guard(connectionsMutex_);
+            if (liveConnections_.size() >= options_.maxConnections) {
+                ::close(clientFd);
+                continue;
+            }
+            liveConnections_.insert(clientFd);
+        }
+        auto connection = std::make_shared<Connection>(clientFd);
+        std::thread([this, connection] { serveConnection(connection); }).detach();
+    }
+
+    ::close(listenFd);
+    ::unlink(options_.socketPath.c_str());
+
+    // Unblock connection readers, let workers finish what is queued, then wait
+    // for the readers so nothing outlives the Server.
+    {
+        std::unique_lock<std::mutex> lock(connectionsMutex_);
+        for (int fd : liveConnections_) ::shutdown(fd, SHUT_RD);
+        connectionsDone_.wait(lock, [this] { return liveConnections_.empty(); });
+    }
+    scheduler_.shutdown();
+    metrics.unregisterGauge("bpm_queue_depth_interactive");
+    metrics.unregisterGauge("bpm_queue_depth_background");
+    return 0;
+}
+
+} // namespace
+
+int runServer(const ServerOptions& options) {
+    Server server(options);
+    return server.run();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "analyzer.h"
+
+// Daemon mode: keeps a warm worker pool (one AnalyzerState per thread) and
+// serves analysis requests over a Unix domain socket.
+//
+// Protocol: tab-separated lines. Clients may pipeline any number of requests
+// on one connection; responses carry the request id and may arrive out of
+// order. Requests with priority > 0 are interactive and preempt background
+// work (priority <= 0) at decode block boundaries; see AnalysisScheduler.
+//
+//   request:  <id> TAB <priority> TAB path TAB <file path> LF
+//             <id> TAB <priority> TAB buffer TAB <byte count> TAB <label> LF <bytes>
+//             <id> TAB 0 TAB playback TAB <0|1> LF     (limits background work while 1)
+//             <id> TAB 0 TAB subscribe TAB - LF        (see below)
+//   response: <id> TAB ok TAB <bpm> TAB <sample rate> TAB <channels> TAB <frames> TAB <peaks> LF
+//             <id> TAB error TAB <message> LF
+//
+// A buffer request larger than maxBufferBytes is answered with
+// "<id> TAB error TAB Buffer too large" and the connection is closed without
+// reading its bytes, since the rest of the stream can no longer be framed.
+//
+// At most maxConnections clients are served at once; further connections are
+// closed as soon as they are accepted.
+//
+// Replies are written by the workers. A client that leaves them unread for
+// five seconds once its socket buffer is full is disconnected.
+//
+// Path results are cached by path, size and modification time, and cache hits
+// are answered on the connection thread without touching the worker pool.
+//
+// With a result ring configured, every result is also published to shared
+// memory (see ResultRingWriter) with its beat grid and waveform overview. A
+// subscribe request is answered with "<id> TAB ok TAB <ring name>" and the
+// ring's notification descriptor attached as SCM_RIGHTS.
+struct ServerOptions {
+    std::string socketPath;
+    AnalyzerConfig config;
+    unsigned threads = 1;
+    float backgroundShare = 0.5f;  // share of workers background jobs may use during playback
+    size_t cacheEntries = 65536;
+    size_t maxBufferBytes = size_t(256) << 20;  // largest accepted buffer request
+    size_t maxConnections = 256;   // each live connection has its own reader thread
+    std::string resultRing;        // POSIX shm name; empty disables the ring
+    uint32_t resultRingCapacity = 4096;
+};
+
+// Runs until SIGINT or SIGTERM. Returns a process exit status.
+int runServer(const ServerOptions& options);
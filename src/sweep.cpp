@@ -0,0 +1,296 @@
+#include "sweep.h"
+
+#include "ground_truth.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+extern std::mutex outputMutex;
+
+namespace {
+
+// Per-configuration totals. Each worker owns one vector of these, merged at the end.
+struct SweepStats {
+    size_t files = 0;
+    size_t correct = 0;
+    double absErrorSum = 0.0;
+    double dspSeconds = 0.0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::string priorLabel(const TempoPrior& prior) {
+    if (prior.maxBpm <= 0.0f) return "none";
+    std::ostringstream label;
+    label << prior.minBpm << ":" << prior.maxBpm;
+    return label.str();
+}
+
+// The swept parameters of `config` as JSON members, without braces.
+std::string configJson(const AnalyzerConfig& config) {
+    std::ostringstream out;
+    if (config.preset == AnalysisPreset::Legacy) {
+        out << "\"threshold\":" << config.threshold << ",\"minGap\":" << config.minGap
+            << ",\"smoothing\":" << config.smoothingFactor;
+    } else {
+        out << "\"hopSize\":" << config.hopSize << ",\"minBpm\":" << config.minBpm << ",\"maxBpm\":" << config.maxBpm
+            << ",\"tempoPrior\":\"" << priorLabel(config.tempoPrior) << "\"";
+    }
+    return out.str();
+}
+
+} // namespace
+
+bool parseSweepList(const char* text, std::vector<float>& values) {
+    values.clear();
+    std::string spec = text;
+    if (spec.find(':') != std::string::npos) {
+        float start = 0.0f, stop = 0.0f, step = 0.0f;
+        char colon1 = 0, colon2 = 0;
+        std::istringstream in(spec);
+        if (!(in >> start >> colon1 >> stop >> colon2 >> step) || colon1 != ':' || colon2 != ':' || step <= 0.0f) {
+            return false;
+        }
+        // Index-based so float accumulation cannot drop the last point.
+        for (int i = 0;; ++i) {
+            float value = start + step * i;
+            if (value > stop + step * 1e-3f) break;
+            values.push_back(value);
+        }
+        return !values.empty();
+    }
+
+    std::istringstream in(spec);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        char* end = nullptr;
+        float value = std::strtof(item.c_str(), &end);
+        if (end == item.c_str() || *end != '\0') return false;
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+int runSweep(const SweepOptions& options) {
+    std::vector<TruthEntry> truth;
+    if (!loadTruth(options.truthPath, truth)) {
+        std::cerr << "Cannot read ground truth: " << options.truthPath << std::endl;
+        return 2;
+    }
+    if (truth.empty()) {
+        std::cerr << "No ground-truth entries in " << options.truthPath << std::endl;
+        return 2;
+    }
+
+    const AnalyzerConfig& base = options.base;
+    const bool legacy = base.preset == AnalysisPreset::Legacy;
+    SweepGrid grid = options.grid;
+    bool peakAxes = !grid.thresholds.empty() || !grid.minGaps.empty() || !grid.smoothingFactors.empty();
+    bool tempoAxes = !grid.hopSizes.empty() || !grid.minBpms.empty() || !grid.maxBpms.empty() ||
+                     !grid.tempoPriors.empty();
+    if (legacy && tempoAxes) {
+        std::cerr << "Hop size, BPM range and tempo prior sweeps need the fast, balanced or accurate preset"
+                  << std::endl;
+        return 2;
+    }
+    if (!legacy && peakAxes) {
+        std::cerr << "Threshold, min-gap and smoothing sweeps only apply to the legacy preset" << std::endl;
+        return 2;
+    }
+    if (grid.thresholds.empty()) grid.thresholds.push_back(base.threshold);
+    if (grid.minGaps.empty()) grid.minGaps.push_back(base.minGap);
+    if (grid.smoothingFactors.empty()) grid.smoothingFactors.push_back(base.smoothingFactor);
+    if (grid.hopSizes.empty()) grid.hopSizes.push_back(base.hopSize);
+    if (grid.minBpms.empty()) grid.minBpms.push_back(base.minBpm);
+    if (grid.maxBpms.empty()) grid.maxBpms.push_back(base.maxBpm);
+    if (grid.tempoPriors.empty()) grid.tempoPriors.push_back(base.tempoPrior);
+
+    // Configurations are ordered by smoothing (Legacy) or hop size first so
+    // those sharing an envelope are adjacent.
+    std::vector<AnalyzerConfig> configs;
+    if (legacy) {
+        for (float smoothing : grid.smoothingFactors) {
+            for (float threshold : grid.thresholds) {
+                for (int minGap : grid.minGaps) {
+                    AnalyzerConfig config = base;
+                    config.smoothingFactor = smoothing;
+                    config.threshold = threshold;
+                    config.minGap = minGap;
+                    configs.push_back(config);
+                }
+            }
+        }
+    } else {
+        for (int hopSize : grid.hopSizes) {
+            for (float minBpm : grid.minBpms) {
+                for (float maxBpm : grid.maxBpms) {
+                    if (minBpm >= maxBpm) continue;
+                    for (const TempoPrior& prior : grid.tempoPriors) {
+                        AnalyzerConfig config = base;
+                        config.hopSize = hopSize;
+                        config.minBpm = minBpm;
+                        config.maxBpm = maxBpm;
+                        config.tempoPrior = prior;
+                        configs.push_back(config);
+                    }
+                }
+            }
+        }
+        if (configs.empty()) {
+            std::cerr << "No swept BPM range has min below max" << std::endl;
+            return 2;
+        }
+    }
+    const size_t perEnvelope = grid.thresholds.size() * grid.minGaps.size();
+    std::vector<Analyzer> analyzers;
+    if (!legacy) {
+        for (const AnalyzerConfig& config : configs) analyzers.emplace_back(config);
+    }
+
+    const Analyzer decoder(base);
+    std::atomic<size_t> nextFile{0};
+    std::atomic<size_t> failures{0};
+    std::vector<std::vector<SweepStats>> workerStats(options.threads, std::vector<SweepStats>(configs.size()));
+    std::vector<double> workerDecodeSeconds(options.threads, 0.0);
+
+    auto sweepStart = Clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < options.threads; ++t) {
+        threads.emplace_back([&, t] {
+            AnalyzerState state;
+            std::vector<SweepStats>& stats = workerStats[t];
+            for (size_t index; (index = nextFile.fetch_add(1)) < truth.size();) {
+                const TruthEntry& entry = truth[index];
+
+                auto decodeStart = Clock::now();
+                AnalysisResult decoded = decoder.decodeFile(entry.path, state);
+                workerDecodeSeconds[t] += secondsSince(decodeStart);
+                if (!decoded.ok) {
+                    failures.fetch_add(1, std::memory_order_relaxed);
+                    std::lock_guard<std::mutex> guard(outputMutex);
+                    std::cerr << "Error processing " << entry.path << ": " << decoded.error << std::endl;
+                    continue;
+                }
+
+                auto score = [&](size_t c, float bpm, double seconds) {
+                    SweepStats& s = stats[c];
+                    s.dspSeconds += seconds;
+                    s.files++;
+                    float error = std::abs(bpm - entry.bpm);
+                    s.absErrorSum += error;
+                    if (error <= options.tolerance * entry.bpm) s.correct++;
+                };
+
+                if (!legacy) {
+                    // Configurations are ordered by hop size, so each run of
+                    // equal hops shares one onset envelope.
+                    double onsetSeconds = 0.0;
+                    for (size_t c = 0; c < configs.size(); ++c) {
+                        if (c == 0 || configs[c].hopSize != configs[c - 1].hopSize) {
+                            AnalysisResult onset = decoded;
+                            analyzers[c].computeOnset(state, onset);
+                            onsetSeconds = onset.analysisSeconds;
+                        }
+                        AnalysisResult result = decoded;
+                        analyzers[c].estimateTempo(state, result);
+                        // Charged to every config, like the Legacy envelope.
+                        score(c, result.bpm, onsetSeconds + result.analysisSeconds);
+                    }
+                    continue;
+                }
+
+                for (size_t envelopeIndex = 0; envelopeIndex < grid.smoothingFactors.size(); ++envelopeIndex) {
+                    auto envelopeStart = Clock::now();
+                    computeEnvelope(state.samples, grid.smoothingFactors[envelopeIndex], state.envelope);
+                    double envelopeSeconds = secondsSince(envelopeStart);
+
+                    for (size_t k = 0; k < perEnvelope; ++k) {
+                        size_t c = envelopeIndex * perEnvelope + k;
+                        auto pickStart = Clock::now();
+                        detectPeaks(state.envelope, configs[c].threshold, configs[c].minGap, state.peaks,
+                                    state.positions);
+                        float bpm = calculateBpm(state.positions, decoded.sampleRate) / base.bpmDivisor;
+                        // Charge the shared envelope to every config so the
+                        // runtime column is what a standalone run would cost.
+                        score(c, bpm, envelopeSeconds + secondsSince(pickStart));
+                    }
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double wallSeconds = secondsSince(sweepStart);
+
+    std::vector<SweepStats> totals(configs.size());
+    double decodeSeconds = 0.0;
+    for (unsigned t = 0; t < options.threads; ++t) {
+        decodeSeconds += workerDecodeSeconds[t];
+        for (size_t c = 0; c < configs.size(); ++c) {
+            totals[c].files += workerStats[t][c].files;
+            totals[c].correct += workerStats[t][c].correct;
+            totals[c].absErrorSum += workerStats[t][c].absErrorSum;
+            totals[c].dspSeconds += workerStats[t][c].dspSeconds;
+        }
+    }
+
+    std::vector<size_t> order(configs.size());
+    for (size_t c = 0; c < order.size(); ++c) order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return totals[a].correct > totals[b].correct;
+    });
+
+    if (options.json) {
+        std::cout << "{\"files\":" << truth.size() << ",\"failed\":" << failures.load()
+                  << ",\"decodeSeconds\":" << decodeSeconds << ",\"wallSeconds\":" << wallSeconds
+                  << ",\"configs\":[";
+        for (size_t i = 0; i < order.size(); ++i) {
+            const SweepStats& s = totals[order[i]];
+            std::cout << (i ? "," : "") << "{" << configJson(configs[order[i]])
+                      << ",\"accuracy\":" << (s.files ? double(s.correct) / s.files : 0.0)
+                      << ",\"meanAbsError\":" << (s.files ? s.absErrorSum / s.files : 0.0)
+                      << ",\"dspSeconds\":" << s.dspSeconds << "}";
+        }
+        std::cout << "]}" << std::endl;
+    } else {
+        std::cout << "Sweep: " << truth.size() << " files (" << failures.load() << " failed), "
+                  << configs.size() << " configurations, decode " << std::fixed << std::setprecision(3)
+                  << decodeSeconds << " s CPU, wall " << wallSeconds << " s\n";
+        if (legacy) {
+            std::cout << std::setw(10) << "threshold" << std::setw(8) << "minGap" << std::setw(10) << "smoothing";
+        } else {
+            std::cout << std::setw(6) << "hop" << std::setw(8) << "minBpm" << std::setw(8) << "maxBpm" << std::setw(10)
+                      << "prior";
+        }
+        std::cout << std::setw(10) << "accuracy" << std::setw(12) << "meanAbsErr" << std::setw(10) << "dsp s" << "\n";
+        for (size_t c : order) {
+            const AnalyzerConfig& config = configs[c];
+            const SweepStats& s = totals[c];
+            if (legacy) {
+                std::cout << std::setw(10) << config.threshold << std::setw(8) << config.minGap << std::setw(10)
+                          << config.smoothingFactor;
+            } else {
+                std::cout << std::setw(6) << config.hopSize << std::setw(8) << config.minBpm << std::setw(8)
+                          << config.maxBpm << std::setw(10) << priorLabel(config.tempoPrior);
+            }
+            std::cout << std::setw(10) << (s.files ? double(s.correct) / s.files : 0.0) << std::setw(12)
+                      << (s.files ? s.absErrorSum / s.files : 0.0) << std::setw(10) << s.dspSeconds << "\n";
+        }
+        std::cout.flush();
+    }
+
+    return failures.load() == 0 ? 0 : 1;
+}
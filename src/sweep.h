@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "analyzer.h"
+
+// Grid of parameters evaluated by the sweep; every combination of the lists
+// is one configuration and an empty list keeps the base value. The
+// peak-picker lists apply to the Legacy preset and the tempo lists to the
+// onset presets (fast, balanced, accurate); runSweep() rejects lists that do
+// not apply to the base preset.
+struct SweepGrid {
+    std::vector<float> thresholds;
+    std::vector<int> minGaps;
+    std::vector<float> smoothingFactors;
+
+    std::vector<int> hopSizes;
+    std::vector<float> minBpms;
+    std::vector<float> maxBpms;
+    std::vector<TempoPrior> tempoPriors;
+};
+
+struct SweepOptions {
+    std::string truthPath;       // TSV of "path<TAB>bpm" lines
+    SweepGrid grid;
+    AnalyzerConfig base;         // supplies the preset, bpmDivisor and any unswept defaults
+    unsigned threads = 1;
+    float tolerance = 0.04f;     // relative BPM error counted as correct
+    bool json = false;
+};
+
+// Parses "a,b,c" or "start:stop:step" into `values`. Returns false on bad input.
+bool parseSweepList(const char* text, std::vector<float>& values);
+
+// Decodes each ground-truth file once and evaluates the whole grid against it
+// with the base preset's pipeline, computing the envelope (Legacy) or onset
+// envelope once per smoothing factor or hop size. Prints one row per
+// configuration and returns a process exit status.
+int runSweep(const SweepOptions& options);
@@ -0,0 +1,116 @@
+#include "synth.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <sndfile.h>
+
+namespace {
+
+constexpr size_t clickFrames = 4000;
+
+// xorshift32: the noise only has to be cheap and reproducible.
+inline float nextNoise(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return static_cast<float>(state) * (2.0f / 4294967296.0f) - 1.0f;
+}
+
+} // namespace
+
+float synthMeanBpm(const SynthTrack& track) {
+    return track.endBpm > 0.0f ? 0.5f * (track.bpm + track.endBpm) : track.bpm;
+}
+
+const char* synthFormatExtension(SynthFormat format) {
+    switch (format) {
+    case SynthFormat::Wav: return "wav";
+    case SynthFormat::Aiff: return "aiff";
+    case SynthFormat::Flac: return "flac";
+    }
+    return "wav";
+}
+
+bool parseSynthFormat(const std::string& name, SynthFormat& format) {
+    if (name == "wav") format = SynthFormat::Wav;
+    else if (name == "aiff") format = SynthFormat::Aiff;
+    else if (name == "flac") format = SynthFormat::Flac;
+    else return false;
+    return true;
+}
+
+void synthesizeTrack(const SynthTrack& track, std::vector<float>& interleaved) {
+    const size_t frames = static_cast<size_t>(track.seconds * track.sampleRate);
+    const size_t channels = static_cast<size_t>(track.channels);
+    const size_t lead = std::min(frames, static_cast<size_t>(track.leadingSilence * track.sampleRate));
+    const size_t trail = std::min(frames - lead, static_cast<size_t>(track.trailingSilence * track.sampleRate));
+    const size_t musicFrames = frames - lead - trail;
+    const double pi = 3.14159265358979323846;
+
+    // Every beat starts the same burst, so compute it once.
+    float click[clickFrames];
+    for (size_t k = 0; k < clickFrames; ++k) {
+        click[k] = 0.8f * float(std::exp(-double(k) / 400.0) * std::sin(2.0 * pi * 1000.0 * k / track.sampleRate));
+    }
+
+    // Beats per frame, ramping linearly across the music. A beat starts
+    // wherever the accumulated beat phase passes an integer.
+    const double startRate = track.bpm / 60.0 / track.sampleRate;
+    const double endRate = (track.endBpm > 0.0f ? track.endBpm : track.bpm) / 60.0 / track.sampleRate;
+    const double rateStep = musicFrames > 1 ? (endRate - startRate) / double(musicFrames - 1) : 0.0;
+
+    uint32_t noiseState = track.seed * 2654435761u + 1u;
+    interleaved.assign(frames * channels, 0.0f);
+    double beatPhase = 0.0;
+    size_t sinceBeat = 0;
+    for (size_t i = 0; i < musicFrames; ++i) {
+        float burst = sinceBeat < clickFrames ? click[sinceBeat] : 0.0f;
+        float* frame = &interleaved[(lead + i) * channels];
+        for (size_t c = 0; c < channels; ++c) {
+            frame[c] = burst + track.noiseLevel * nextNoise(noiseState);
+        }
+
+        double next = beatPhase + startRate + rateStep * double(i);
+        sinceBeat = std::floor(next) != std::floor(beatPhase) ? 0 : sinceBeat + 1;
+        beatPhase = next;
+    }
+}
+
+bool writeAudioFile(const std::string& path, const std::vector<float>& interleaved, int sampleRate, int channels,
+                    SynthFormat format, std::string& error) {
+    SF_INFO info = {};
+    info.samplerate = sampleRate;
+    info.channels = channels;
+    switch (format) {
+    case SynthFormat::Wav: info.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16; break;
+    case SynthFormat::Aiff: info.format = SF_FORMAT_AIFF | SF_FORMAT_PCM_16; break;
+    case SynthFormat::Flac: info.format = SF_FORMAT_FLAC | SF_FORMAT_PCM_16; break;
+    }
+    SNDFILE* file = sf_open(path.c_str(), SFM_WRITE, &info);
+    if (!file) {
+        error = std::string("Cannot write ") + path + ": " + sf_strerror(nullptr);
+        return false;
+    }
+    sf_count_t frames = static_cast<sf_count_t>(interleaved.size() / channels);
+    bool ok = sf_writef_float(file, interleaved.data(), frames) == frames;
+    sf_close(file);
+    if (!ok) error = "Short write to " + path;
+    return ok;
+}
+
+bool writeSyntheticCorpus(const std::string& directory, size_t files, double seconds,
+                          std::vector<TruthEntry>& entries, std::string& error) {
+    std::vector<float> audio;
+    for (size_t i = 0; i < files; ++i) {
+        SynthTrack track;
+        track.bpm = 80.0f + float((i * 37) % 100);
+        track.seconds = seconds;
+        track.seed = static_cast<uint32_t>(i + 1);
+        synthesizeTrack(track, audio);
+        std::string path = directory + "/track" + std::to_string(i) + ".wav";
+        if (!writeAudioFile(path, audio, track.sampleRate, track.channels, track.format, error)) return false;
+        entries.push_back({path, track.bpm});
+    }
+    return true;
+}
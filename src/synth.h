@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ground_truth.h"
+
+enum class SynthFormat { Wav, Aiff, Flac };
+
+// Deterministic synthetic audio for benchmarks and load tests: a decaying
+// tone burst on every beat over noise, so every preset finds a tempo.
+struct SynthTrack {
+    float bpm = 120.0f;
+    float endBpm = 0.0f;           // tempo at the end of the music; 0 keeps `bpm` throughout
+    double seconds = 30.0;         // total length, silence included
+    double leadingSilence = 0.0;   // digital silence before the first beat, in seconds
+    double trailingSilence = 0.0;  // digital silence after the last beat, in seconds
+    float noiseLevel = 0.02f;      // peak amplitude of the background noise
+    int sampleRate = 44100;
+    int channels = 2;
+    SynthFormat format = SynthFormat::Wav;
+    uint32_t seed = 1;
+};
+
+// Mean tempo over the music, i.e. the BPM a correct analysis should report.
+float synthMeanBpm(const SynthTrack& track);
+
+const char* synthFormatExtension(SynthFormat format);
+bool parseSynthFormat(const std::string& name, SynthFormat& format);
+
+// Fills `interleaved` with seconds * sampleRate frames of `track`.
+void synthesizeTrack(const SynthTrack& track, std::vector<float>& interleaved);
+
+// Writes 16-bit PCM in `format`. Returns false and fills `error` on failure.
+bool writeAudioFile(const std::string& path, const std::vector<float>& interleaved, int sampleRate, int channels,
+                    SynthFormat format, std::string& error);
+
+// Writes `files` tracks of `seconds` each into `directory` (which must exist)
+// at tempos spread over 80-179 BPM, appending their paths and tempos to
+// `entries`. Returns false and fills `error` on the first failed write.
+bool writeSyntheticCorpus(const std::string& directory, size_t files, double seconds,
+                          std::vector<TruthEntry>& entries, std::string& error);
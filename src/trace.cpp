@@ -0,0 +1,207 @@
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const std::string* detail;  // interned in the thread's TraceBuffer, or null
+    long long startNs;
+    long long durationNs;
+};
+
+// Events live in fixed-size chunks that are never moved, so the owning thread
+// appends with a release store of `count` and a reader sees a consistent prefix.
+struct TraceChunk {
+    static constexpr size_t capacity = 4096;
+    TraceEvent events[capacity];
+    std::atomic<size_t> count{0};
+    std::atomic<TraceChunk*> next{nullptr};
+};
+
+struct TraceBuffer {
+    int threadId = 0;
+    std::string threadName;
+    TraceChunk* head = nullptr;
+    TraceChunk* tail = nullptr;
+    // Event details, interned once per run of equal details (in practice once
+    // per file). push_back never moves the elements events point to.
+    std::deque<std::string> details;
+};
+
+const std::string* intern(TraceBuffer& buffer, const std::string& detail) {
+    if (buffer.details.empty() || buffer.details.back() != detail) buffer.details.push_back(detail);
+    return &buffer.details.back();
+}
+
+// Bounds the timeline of a long-running process such as the daemon: once
+// this many chunks (about 128 MiB of events) exist, recording stops.
+constexpr size_t maxTraceChunks = 1024;
+std::atomic<size_t> traceChunks{0};
+std::atomic<bool> traceFull{false};
+
+// Claims a chunk from the budget, warning once when it runs out.
+bool reserveChunk() {
+    if (traceChunks.fetch_add(1, std::memory_order_relaxed) < maxTraceChunks) return true;
+    if (!traceFull.exchange(true, std::memory_order_relaxed)) {
+        std::cerr << "Trace buffer full; later events are not recorded" << std::endl;
+    }
+    return false;
+}
+
+const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+std::mutex buffersMutex;
+std::vector<TraceBuffer*> buffers;  // never freed: events must survive their threads
+
+// The calling thread's buffer, or null once the trace budget is spent.
+TraceBuffer* localBuffer() {
+    thread_local TraceBuffer* buffer = nullptr;
+    if (!buffer) {
+        if (!reserveChunk()) return nullptr;
+        buffer = new TraceBuffer();
+        buffer->head = buffer->tail = new TraceChunk();
+        std::lock_guard<std::mutex> guard(buffersMutex);
+        buffer->threadId = static_cast<int>(buffers.size()) + 1;
+        buffer->threadName = "thread " + std::to_string(buffer->threadId);
+        buffers.push_back(buffer);
+    }
+    return buffer;
+}
+
+void writeEscaped(std::ostream& out, const std::string& text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+}
+
+} // namespace
+
+namespace trace_detail {
+
+bool enabled = false;
+bool timeline = false;
+bool counters = false;
+bool metrics = false;
+
+long long nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch)
+        .count();
+}
+
+void record(const char* name, const std::string* detail, MetricStage stage, long long startNs,
+            const PerfSample& begin) {
+    long long endNs = nowNs();
+    if (counters) recordPerfStage(name, detail, begin);
+    if (metrics && stage != MetricStage::Count) Metrics::instance().recordStage(stage, (endNs - startNs) / 1e9);
+    if (!timeline || traceFull.load(std::memory_order_relaxed)) return;
+
+    TraceBuffer* owner = localBuffer();
+    if (!owner) return;
+    TraceBuffer& buffer = *owner;
+    TraceChunk* chunk = buffer.tail;
+    size_t index = chunk->count.load(std::memory_order_relaxed);
+    if (index == TraceChunk::capacity) {
+        if (!reserveChunk()) return;
+        TraceChunk* fresh = new TraceChunk();
+        chunk->next.store(fresh, std::memory_order_release);
+        buffer.tail = chunk = fresh;
+        index = 0;
+    }
+    TraceEvent& event = chunk->events[index];
+    event.name = name;
+    event.detail = detail ? intern(buffer, *detail) : nullptr;
+    event.startNs = startNs;
+    event.durationNs = endNs - startNs;
+    chunk->count.store(index + 1, std::memory_order_release);
+}
+
+} // namespace trace_detail
+
+void enableTrace() {
+    trace_detail::enabled = trace_detail::timeline = true;
+}
+
+void enableTraceCounters() {
+    trace_detail::enabled = trace_detail::counters = true;
+}
+
+void enableTraceMetrics() {
+    trace_detail::enabled = trace_detail::metrics = true;
+}
+
+void setTraceThreadName(const std::string& name) {
+    if (trace_detail::counters) setPerfThreadName(name);
+    if (!trace_detail::timeline) return;
+    TraceBuffer* buffer = localBuffer();
+    if (!buffer) return;
+    std::lock_guard<std::mutex> guard(buffersMutex);
+    buffer->threadName = name;
+}
+
+bool writeTrace(const std::string& path, std::string& error) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        error = "Cannot write trace to " + path;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(buffersMutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&] {
+        if (!first) out << ",\n";
+        first = false;
+    };
+
+    char timestamp[64];
+    for (const TraceBuffer* buffer : buffers) {
+        separator();
+        out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadId
+            << ",\"args\":{\"name\":\"";
+        writeEscaped(out, buffer->threadName);
+        out << "\"}}";
+
+        for (const TraceChunk* chunk = buffer->head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            size_t count = chunk->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; ++i) {
+                const TraceEvent& event = chunk->events[i];
+                separator();
+                // Chrome trace timestamps are microseconds.
+                std::snprintf(timestamp, sizeof(timestamp), "\"ts\":%.3f,\"dur\":%.3f", event.startNs / 1e3,
+                              event.durationNs / 1e3);
+                out << "{\"ph\":\"X\",\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":" << buffer->threadId
+                    << ',' << timestamp;
+                if (event.detail && !event.detail->empty()) {
+                    out << ",\"args\":{\"detail\":\"";
+                    writeEscaped(out, *event.detail);
+                    out << "\"}";
+                }
+                out << '}';
+            }
+        }
+    }
+    out << "\n]}\n";
+
+    if (!out) {
+        error = "Cannot write trace to " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+
+#include "metrics.h"
+#include "perf_counters.h"
+
+// Optional timeline of what each thread is doing, written as Chrome trace
+// event JSON (load in Perfetto or chrome://tracing). Every thread appends to
+// its own buffer without locking; buffers are only read by writeTrace().
+// The timeline is capped at about 128 MiB; past that, events are dropped
+// with a single warning, so a daemon traced for hours keeps its first ones.
+// The same scopes also feed the hardware counters when those are enabled,
+// and scopes tagged with a MetricStage the stage latency histograms.
+//
+// enableTrace()/enableTraceCounters()/enableTraceMetrics() must be called
+// before any worker starts. While all are off, a TraceScope costs one load and one
+// well-predicted branch.
+
+namespace trace_detail {
+extern bool enabled;   // timeline or counters
+extern bool timeline;
+extern bool counters;
+extern bool metrics;
+void record(const char* name, const std::string* detail, MetricStage stage, long long startNs,
+            const PerfSample& counters);
+long long nowNs();
+} // namespace trace_detail
+
+inline bool traceEnabled() {
+    return trace_detail::enabled;
+}
+
+void enableTrace();
+void enableTraceCounters();
+void enableTraceMetrics();  // tagged scopes feed Metrics::recordStage()
+
+// Names the calling thread in the trace (e.g. "worker 3").
+void setTraceThreadName(const std::string& name);
+
+// Writes every event recorded so far. Call once the traced threads are idle.
+bool writeTrace(const std::string& path, std::string& error);
+
+// Records a complete event covering the scope's lifetime. `name` must be a
+// string literal; `detail` (e.g. the file path) is copied only when tracing,
+// and then once per file. A scope tagged with `stage` also adds its duration
+// to that stage's histogram; tagged scopes must not nest within the same stage.
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, const std::string* detail = nullptr) {
+        if (traceEnabled()) start(name, detail);
+    }
+    TraceScope(const char* name, MetricStage stage) {
+        if (traceEnabled()) {
+            start(name, nullptr);
+            stage_ = stage;
+        }
+    }
+    ~TraceScope() {
+        if (name_) trace_detail::record(name_, detail_, stage_, startNs_, counters_);
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    void start(const char* name, const std::string* detail) {
+        name_ = name;
+        detail_ = detail;
+        startNs_ = trace_detail::nowNs();
+        if (trace_detail::counters) readPerfCounters(counters_);
+    }
+
+    const char* name_ = nullptr;
+    const std::string* detail_ = nullptr;
+    MetricStage stage_ = MetricStage::Count;  // Count: no histogram
+    long long startNs_ = 0;
+    PerfSample counters_;
+};
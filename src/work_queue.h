@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// Bounded multi-producer/multi-consumer queue. The bound keeps memory flat when
+// a producer (directory walk, stdin file list) is much faster than the workers.
+// Contention counters, cheap enough to keep on in production builds.
+struct WorkQueueStats {
+    uint64_t contendedLocks = 0;  // lock acquisitions that found the mutex held
+    uint64_t emptyWaits = 0;      // pops that blocked on an empty queue
+    uint64_t fullWaits = 0;       // pushes that blocked on a full queue
+};
+
+template <typename T>
+class WorkQueue {
+public:
+    explicit WorkQueue(size_t capacity) : capacity_(capacity) {}
+
+    // Blocks while the queue is full. Returns false if the queue was closed.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock = acquire();
+        if (!closed_ && items_.size() >= capacity_) fullWaits_.fetch_add(1, std::memory_order_relaxed);
+        notFull_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    // Blocks while the queue is empty. Returns false once closed and drained.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock = acquire();
+        if (!closed_ && items_.empty()) emptyWaits_.fetch_add(1, std::memory_order_relaxed);
+        notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    // Like pop(), but takes up to `max` items under one lock acquisition.
+    // Returns false once closed and drained; otherwise `items` is non-empty.
+    bool popBatch(std::vector<T>& items, size_t max) {
+        items.clear();
+        std::unique_lock<std::mutex> lock = acquire();
+        if (!closed_ && items_.empty()) emptyWaits_.fetch_add(1, std::memory_order_relaxed);
+        notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        while (!items_.empty() && items.size() < max) {
+            items.push_back(std::move(items_.front()));
+            items_.pop_front();
+        }
+        if (items.empty()) return false;
+        notFull_.notify_all();
+        return true;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return items_.size();
+    }
+
+    // No more items will be pushed; workers drain what is left and exit.
+    void close() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+    WorkQueueStats stats() const {
+        WorkQueueStats stats;
+        stats.contendedLocks = contendedLocks_.load(std::memory_order_relaxed);
+        stats.emptyWaits = emptyWaits_.load(std::memory_order_relaxed);
+        stats.fullWaits = fullWaits_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    std::unique_lock<std::mutex> acquire() {
+        std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            contendedLocks_.fetch_add(1, std::memory_order_relaxed);
+            lock.lock();
+        }
+        return lock;
+    }
+
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<T> items_;
+    size_t capacity_;
+    bool closed_ = false;
+    std::atomic<uint64_t> contendedLocks_{0};
+    std::atomic<uint64_t> emptyWaits_{0};
+    std::atomic<uint64_t> fullWaits_{0};
+};
+